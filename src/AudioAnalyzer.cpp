@@ -0,0 +1,261 @@
+#include "AudioAnalyzer.h"
+#include "CycleCounter.h"
+
+namespace {
+    // Bins are 31.25 Hz apart at 16 kHz.
+    struct BandBins {
+        uint16_t firstBin;
+        uint16_t lastBin;
+    };
+
+    const BandBins bandBins[AudioFeatures::bandCount] = {
+        {2, 8},     // ~60 to 250 Hz
+        {9, 64},    // ~250 Hz to 2 kHz
+        {65, 255},  // ~2 to 8 kHz
+    };
+}
+
+bool AudioAnalyzer::update() {
+    if (!recorder.isRecording()) {
+        cursorValid = false;
+        return false;
+    }
+
+    uint32_t end = recorder.position();
+    uint32_t blockSize = recorder.blockSize();
+
+    // Start over whenever the recording does, e.g. for a scene that wants other settings.
+    if (!cursorValid || recorder.session() != session) {
+        cursor = end - blockSize;
+        cursorValid = true;
+        session = recorder.session();
+        analyzedSamples = 0;
+        levelGain.reset(0);
+        soundGestures.configure(recorder.sampleRate());
+    }
+
+    uint32_t elapsed = end - cursor;
+
+    if (elapsed < blockSize) {
+        return false;
+    }
+
+    // Only the newest window matters, so skip any blocks in between.
+    elapsed -= elapsed % blockSize;
+    cursor += elapsed;
+    analyzedSamples += elapsed;
+
+    // Borrow everything this update reads from the recorder, so it's all read
+    // in place, and the PDM callback can't overwrite any of it meanwhile.
+    uint32_t count = windowSize;
+
+    if (spectrumEnabled && longWindowEnabled) {
+        count = AudioFeatures::longWindowSize;
+    }
+
+    if (filterBank.count() > 0 || soundGesturesEnabled) {
+        count = max(count, min(elapsed, maxStreamedSamples));
+    }
+
+    leasedSamples = recorder.lease(cursor, count);
+    leasedCount = count;
+
+    if (leasedSamples == nullptr) {
+        return false;
+    }
+
+    const int16_t* samples = newestSamples(windowSize);
+    uint32_t startCycles = CycleCounter::now();
+
+    // The gain control runs on audio time, not frame time.
+    float dtMs = elapsed * 1000.0f / recorder.sampleRate();
+
+    analyzeLevels(dtMs);
+
+    if (filterBank.count() > 0) {
+        analyzeFilterBands(elapsed, dtMs);
+    }
+
+    if (soundGesturesEnabled) {
+        analyzeSoundGestures(elapsed);
+    }
+
+    if (spectrumEnabled) {
+        analyzeSpectrum(samples, dtMs);
+        analyzeBeats(elapsed);
+
+        if (longWindowEnabled) {
+            analyzeLongWindow(elapsed);
+        }
+    }
+
+    current.hasSpectrum = spectrumEnabled;
+    current.timeMs = uint32_t(analyzedSamples * 1000 / recorder.sampleRate());
+    current.version++;
+
+    recorder.release();
+    leasedSamples = nullptr;
+
+    analysisCycles = CycleCounter::since(startCycles);
+    return true;
+}
+
+void AudioAnalyzer::setSpectrumEnabled(bool enabled) {
+    if (enabled && !spectrumEnabled) {
+        beats.reset();
+        beatSamples = 0;
+        spectrumGain.reset(initialSpectrumCeiling);
+    }
+
+    spectrumEnabled = enabled;
+
+    if (!enabled) {
+        current.hasSpectrum = false;
+        current.bpm = 0;
+        current.beatPhase = 0;
+    }
+}
+
+void AudioAnalyzer::setLongWindowEnabled(bool enabled) {
+    // Analyze it on the next update.
+    if (enabled && !longWindowEnabled) {
+        longWindowSamples = longWindowHop;
+    }
+
+    longWindowEnabled = enabled;
+
+    if (!enabled) {
+        memset(current.longSpectrum, 0, sizeof(current.longSpectrum));
+    }
+}
+
+void AudioAnalyzer::setSoundGesturesEnabled(bool enabled) {
+    if (enabled && !soundGesturesEnabled) {
+        soundGestures.configure(recorder.sampleRate());
+    }
+
+    soundGesturesEnabled = enabled;
+
+    if (!enabled) {
+        current.whistling = false;
+        current.whistleHz = 0;
+    }
+}
+
+void AudioAnalyzer::setFilterBands(const GoertzelBand* bands, uint8_t count) {
+    filterBank.configure(bands, count, recorder.sampleRate());
+    filterGain.reset(0);
+
+    current.filterBandCount = filterBank.count();
+    memset(current.filterBands, 0, sizeof(current.filterBands));
+    memset(current.filterBandLevels, 0, sizeof(current.filterBandLevels));
+}
+
+void AudioAnalyzer::analyzeLevels(float dtMs) {
+    // The recorder keeps these up to date as samples arrive.
+    current.dc = recorder.dc();
+    current.rms = recorder.rms();
+    current.peak = recorder.peak();
+
+    float reading = max(current.rms - levelFloor, 0.0f);
+    levelGain.update(reading, dtMs);
+    current.level = min(levelGain.normalize(reading), 1.0f);
+}
+
+void AudioAnalyzer::analyzeSpectrum(const int16_t* samples, float dtMs) {
+    fft.log2Magnitudes(samples, 1, AudioFeatures::binCount - 1, current.spectrum);
+    current.spectrum[0] = 0;
+
+    uint16_t loudest = 0;
+
+    for (uint16_t i = bandBins[AudioFeatures::bass].firstBin; i <= bandBins[AudioFeatures::mids].lastBin; i++) {
+        loudest = max(loudest, current.spectrum[i]);
+    }
+
+    current.spectrumCeiling = uint16_t(spectrumGain.update(loudest, dtMs));
+
+    for (uint8_t b = 0; b < AudioFeatures::bandCount; b++) {
+        const BandBins& bins = bandBins[b];
+        uint32_t sum = 0;
+
+        for (uint16_t i = bins.firstBin; i <= bins.lastBin; i++) {
+            sum += current.spectrum[i];
+        }
+
+        current.bands[b] = sum / (bins.lastBin - bins.firstBin + 1);
+    }
+}
+
+void AudioAnalyzer::analyzeLongWindow(uint32_t elapsed) {
+    longWindowSamples += elapsed;
+
+    if (longWindowSamples < longWindowHop) {
+        return;
+    }
+
+    const int16_t* samples = newestSamples(AudioFeatures::longWindowSize);
+    longWindowSamples = 0;
+
+    // Averaging is a crude low pass, but it nulls what would alias
+    // onto the bottom bins, and those are the only ones used.
+    const uint32_t decimation = AudioFeatures::longWindowDecimation;
+
+    for (uint32_t i = 0; i < windowSize; i++) {
+        int32_t sum = 0;
+
+        for (uint32_t j = 0; j < decimation; j++) {
+            sum += samples[i * decimation + j];
+        }
+
+        longWindow[i] = sum / int32_t(decimation);
+    }
+
+    fft.log2Magnitudes(longWindow, 1, AudioFeatures::binCount - 1, current.longSpectrum);
+    current.longSpectrum[0] = 0;
+}
+
+void AudioAnalyzer::analyzeBeats(uint32_t elapsed) {
+    beatSamples += elapsed;
+    uint32_t steps = beatSamples / beatStepSize;
+    beatSamples %= beatStepSize;
+
+    if (beats.update(current.spectrum, steps)) {
+        current.onsetCount++;
+        current.onsetStrength = beats.lastOnsetStrength();
+    }
+
+    current.beatCount = beats.beatCount();
+    current.bpm = beats.bpm();
+    current.beatPhase = beats.beatPhase();
+}
+
+void AudioAnalyzer::analyzeFilterBands(uint32_t elapsed, float dtMs) {
+    // Every sample since the last update, not just the newest window.
+    uint32_t count = min(elapsed, maxStreamedSamples);
+    filterBank.process(newestSamples(count), count);
+
+    float loudest = 0;
+
+    for (uint8_t b = 0; b < filterBank.count(); b++) {
+        current.filterBands[b] = filterBank.amplitude(b);
+        loudest = max(loudest, current.filterBands[b]);
+    }
+
+    filterGain.update(max(loudest - levelFloor, 0.0f), dtMs);
+
+    for (uint8_t b = 0; b < filterBank.count(); b++) {
+        float reading = max(current.filterBands[b] - levelFloor, 0.0f);
+        current.filterBandLevels[b] = min(filterGain.normalize(reading), 1.0f);
+    }
+}
+
+void AudioAnalyzer::analyzeSoundGestures(uint32_t elapsed) {
+    uint32_t count = min(elapsed, maxStreamedSamples);
+    soundGestures.process(newestSamples(count), count);
+
+    current.clapCount = soundGestures.clapCount();
+    current.doubleClapCount = soundGestures.doubleClapCount();
+
+    current.whistling = soundGestures.isWhistling();
+    current.whistleHz = soundGestures.whistleFrequency();
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <Arduino.h>
+#include "PdmRecorder.h"
+#include "Q15RealFft.h"
+#include "BeatDetector.h"
+#include "AutoGain.h"
+#include "GoertzelBank.h"
+#include "SoundGestures.h"
+
+// Everything the scenes want to know about the audio, computed once per block.
+struct AudioFeatures {
+    static constexpr uint32_t windowSize = PdmRecorder::sampleCount;
+    static constexpr uint16_t binCount = windowSize / 2;
+    static constexpr uint8_t maxFilterBands = 4;
+
+    // The long window is four times as long, averaged down to the same number
+    // of samples, so its bins are four times finer over the bottom quarter.
+    static constexpr uint32_t longWindowDecimation = 4;
+    static constexpr uint32_t longWindowSize = windowSize * longWindowDecimation;
+
+    enum Band: uint8_t {
+        bass = 0,
+        mids,
+        highs,
+        bandCount
+    };
+
+    // Bumped every time new features are published, so scenes can
+    // tell whether there's anything new since they last looked.
+    uint32_t version = 0;
+
+    // Audio time at the end of the analyzed window, in milliseconds since
+    // recording started. Features only change once per block, so anything
+    // that wants to move smoothly between them can use this to interpolate
+    // (see InterpolatedBands).
+    uint32_t timeMs = 0;
+
+    // Running loudness with the DC offset removed, in sample units.
+    float rms = 0;
+
+    // Recent peak level, decaying between peaks.
+    uint16_t peak = 0;
+
+    // The mic's DC offset, which the recorder filters out.
+    float dc = 0;
+
+    // rms run through the automatic gain control, so it's 0 in a quiet
+    // room and around 1 at whatever volume has been usual lately.
+    float level = 0;
+
+    // Claps and whistles (see SoundGestures), while they're enabled. The counts
+    // count up, so anything at any frame rate can tell whether it missed one.
+    uint32_t clapCount = 0;
+    uint32_t doubleClapCount = 0;
+    bool whistling = false;
+    float whistleHz = 0;
+
+    // Only computed while a scene has set filter bands. How many there are,
+    // the amplitude of each in sample units, and the amplitudes run through
+    // one automatic gain control, so the loudest band is around 1.
+    uint8_t filterBandCount = 0;
+    float filterBands[maxFilterBands] = {};
+    float filterBandLevels[maxFilterBands] = {};
+
+    // Everything below is only computed while the spectrum is enabled.
+    bool hasSpectrum = false;
+
+    // Mean log2 magnitude of the bins in each band, in Q8.
+    uint16_t bands[bandCount] = {};
+
+    // log2 magnitude of each FFT bin, in Q8.
+    uint16_t spectrum[binCount] = {};
+
+    // log2 magnitude of each bin of the long window, in Q8, 7.8 Hz apart up to 2 kHz.
+    // Only computed while the long window is enabled too.
+    uint16_t longSpectrum[binCount] = {};
+
+    // What the loudest bass or mids bins have been lately, per the
+    // automatic gain control. The top of the scale for graphing the spectrum.
+    uint16_t spectrumCeiling = 0;
+
+    // Counts up on every onset and every beat, so scenes running
+    // at any frame rate can tell whether they've missed one.
+    uint32_t onsetCount = 0;
+    uint32_t beatCount = 0;
+
+    // How far the last onset was over the detection threshold.
+    float onsetStrength = 0;
+
+    // 0 until a steady tempo is found.
+    float bpm = 0;
+
+    // 0 to 1 between beats, 0 on the beat.
+    float beatPhase = 0;
+};
+
+// Analyzes the newest window of audio from the PdmRecorder each time a new block
+// of samples has arrived, and publishes the results for any scene to read.
+// The FFT is the expensive part, so it only runs while a scene asks for it.
+class AudioAnalyzer {
+public:
+    // A new block each time the recorder has recorded its block size
+    // (by default every 8 ms at 16 kHz); consecutive windows overlap.
+    static constexpr uint32_t windowSize = AudioFeatures::windowSize;
+
+    // Swap in ZeroFftBackend (from ZeroFftBackend.h) to compare.
+    typedef Q15RealFft<windowSize> FftBackend;
+
+    // The beat detector steps at a fixed rate, whatever the block size.
+    static constexpr uint32_t beatStepSize = 128;
+    typedef BeatDetector<PdmRecorder::defaultSampleRate / beatStepSize, AudioFeatures::binCount> Beats;
+
+public:
+    AudioAnalyzer(const PdmRecorder& r) : recorder(r) {}
+
+    // Call once each frame, after the recorder's sync(). Does nothing
+    // unless the recorder is recording. Returns true if new features were published.
+    bool update();
+
+    inline const AudioFeatures& features() const {
+        return current;
+    }
+
+    // Scenes that want the spectrum, or the onsets and beats found in it,
+    // turn it on in enter() and off in exit(). It assumes the recorder is
+    // running at PdmRecorder::defaultSampleRate.
+    void setSpectrumEnabled(bool enabled);
+
+    inline bool isSpectrumEnabled() const {
+        return spectrumEnabled;
+    }
+
+    // Scenes that want finer bass bins than the spectrum's (e.g. for a LogFilterbank)
+    // turn on the long window as well. Its spectrum is updated every longWindowHop
+    // samples, since it changes slowly and costs as much as the spectrum.
+    static constexpr uint32_t longWindowHop = windowSize;
+
+    void setLongWindowEnabled(bool enabled);
+
+    inline bool isLongWindowEnabled() const {
+        return longWindowEnabled;
+    }
+
+    // Listen for claps and whistles, whatever else is enabled. They're cheap enough
+    // to leave on all the time, as long as something is recording.
+    void setSoundGesturesEnabled(bool enabled);
+
+    inline bool isSoundGesturesEnabled() const {
+        return soundGesturesEnabled;
+    }
+
+    // For scenes that only need a few bands, a Goertzel filter per band is much
+    // cheaper than the spectrum. Set them in enter(), after starting the recorder
+    // (they're tuned to its sample rate), and set none in exit().
+    void setFilterBands(const GoertzelBand* bands, uint8_t count);
+
+    // How long the last analysis took. See CycleCounter.
+    inline uint32_t lastAnalysisCycles() const {
+        return analysisCycles;
+    }
+
+private:
+    void analyzeLevels(float dtMs);
+    void analyzeSpectrum(const int16_t* samples, float dtMs);
+    void analyzeLongWindow(uint32_t elapsed);
+    void analyzeBeats(uint32_t elapsed);
+    void analyzeFilterBands(uint32_t elapsed, float dtMs);
+    void analyzeSoundGestures(uint32_t elapsed);
+
+    // The newest count of the samples leased from the recorder for this update.
+    inline const int16_t* newestSamples(uint32_t count) const {
+        return leasedSamples + leasedCount - count;
+    }
+
+private:
+    const PdmRecorder& recorder;
+    AudioFeatures current;
+
+    FftBackend fft;
+    bool spectrumEnabled = false;
+
+    bool longWindowEnabled = false;
+    uint32_t longWindowSamples = 0;
+    int16_t longWindow[windowSize];
+
+    Beats beats;
+    uint32_t beatSamples = 0;
+
+    GoertzelBank<AudioFeatures::maxFilterBands> filterBank;
+
+    bool soundGesturesEnabled = false;
+    SoundGestures soundGestures;
+
+    // Both the filters and the gestures see every sample, but after a long
+    // stall they skip ahead rather than hold a huge lease (or blow the frame).
+    static constexpr uint32_t maxStreamedSamples = AudioFeatures::longWindowSize;
+
+    // Both follow rises within a couple of frames, and take a while to let go.
+    // rms below levelFloor is just the room.
+    static constexpr float levelFloor = 10;
+    AutoGain levelGain{50, 500, 75};
+    AutoGain filterGain{50, 500, 75};
+
+    // The spectrum's is in Q8 log2, starting from a loud ~14.4 so the
+    // bars don't jump when the spectrum is turned on, and never below ~3.6.
+    static constexpr float initialSpectrumCeiling = 3693;
+    AutoGain spectrumGain{25, 250, 923};
+
+    uint32_t cursor = 0;
+    bool cursorValid = false;
+    uint32_t session = 0;
+    uint64_t analyzedSamples = 0;
+
+    const int16_t* leasedSamples = nullptr;
+    uint32_t leasedCount = 0;
+
+    uint32_t analysisCycles = 0;
+};
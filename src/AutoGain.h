@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Automatic gain control. Follows how loud a signal has been lately, rising with
+// the attack time and falling with the release time, so that it can be divided
+// out. The times are in milliseconds, so it behaves the same at any frame rate.
+class AutoGain {
+public:
+    AutoGain(float attackMs, float releaseMs, float minReference) :
+        attackMs(attackMs),
+        releaseMs(releaseMs),
+        minReference(minReference),
+        reference(minReference)
+    {
+    }
+
+    void reset(float r) {
+        reference = max(r, minReference);
+    }
+
+    // Move toward value over dtMs milliseconds, and return the new reference.
+    float update(float value, float dtMs) {
+        float timeConstant = value > reference ? attackMs : releaseMs;
+        reference += (value - reference) * (1.0f - expf(-dtMs / timeConstant));
+        reference = max(reference, minReference);
+        return reference;
+    }
+
+    // Scale value so that the reference level is 1.
+    inline float normalize(float value) const {
+        return value / reference;
+    }
+
+    inline float getReference() const {
+        return reference;
+    }
+
+private:
+    float attackMs;
+    float releaseMs;
+    float minReference;
+    float reference;
+};
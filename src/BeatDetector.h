@@ -0,0 +1,232 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Finds onsets in a stream of log2 spectra using spectral flux, and tracks the
+// tempo and beat phase from them.
+//
+// Everything advances one step per audio block (BLOCK_RATE steps per second),
+// and each step costs the same no matter what the audio is doing: one pass over
+// the flux bins, and one over the candidate tempo lags.
+template<uint32_t BLOCK_RATE, uint16_t BIN_COUNT>
+class BeatDetector {
+public:
+    static constexpr float minBpm = 60;
+    static constexpr float maxBpm = 180;
+
+    // Flux is summed over the bins below ~4 kHz, where the kicks, snares and claps are.
+    static constexpr uint16_t firstFluxBin = 1;
+    static constexpr uint16_t lastFluxBin = BIN_COUNT / 2;
+
+    // The range of beat periods, in blocks.
+    static constexpr uint16_t minLag = uint16_t(BLOCK_RATE * 60 / maxBpm);
+    static constexpr uint16_t maxLag = uint16_t(BLOCK_RATE * 60 / minBpm + 0.5f);
+    static constexpr uint16_t lagCount = maxLag - minLag + 1;
+
+    // Power of two, so the history index can wrap with a mask.
+    static constexpr uint16_t historySize = 256;
+    static_assert(maxLag < historySize, "historySize is too small for minBpm");
+
+public:
+    BeatDetector() {
+        // Bias the tempo toward 120 BPM, falling off by about an octave either way,
+        // so it doesn't lock onto half or double time as easily.
+        const float preferredLag = BLOCK_RATE * 60 / 120.0f;
+
+        for (uint16_t i = 0; i < lagCount; i++) {
+            float octaves = log2f((minLag + i) / preferredLag);
+            lagWeights[i] = expf(-0.5f * octaves * octaves);
+        }
+
+        reset();
+    }
+
+    void reset() {
+        memset(previousSpectrum, 0, sizeof(previousSpectrum));
+        memset(history, 0, sizeof(history));
+        memset(correlation, 0, sizeof(correlation));
+
+        hasPreviousSpectrum = false;
+        historyIndex = 0;
+        energy = 0;
+        fluxMean = 0;
+        fluxDeviation = 0;
+        blocksSinceOnset = refractoryBlocks;
+        period = 0;
+        phase = 0;
+        confidence = 0;
+    }
+
+    // Call with each new spectrum. blocks is how many blocks have passed since
+    // the previous one, since the analyzer skips blocks when it falls behind.
+    // Returns true if the spectrum has an onset in it.
+    bool update(const uint16_t* log2Q8Spectrum, uint32_t blocks) {
+        uint32_t flux = 0;
+
+        // Only increases count; a note ending isn't an onset.
+        for (uint16_t i = firstFluxBin; i <= lastFluxBin; i++) {
+            int32_t rise = int32_t(log2Q8Spectrum[i]) - previousSpectrum[i];
+            flux += max(rise, int32_t(0));
+            previousSpectrum[i] = log2Q8Spectrum[i];
+        }
+
+        // The first spectrum has nothing to compare to.
+        if (!hasPreviousSpectrum) {
+            hasPreviousSpectrum = true;
+            return false;
+        }
+
+        // Mean rise per bin, in log2 units.
+        float value = flux / (256.0f * (lastFluxBin - firstFluxBin + 1));
+
+        // Adaptive threshold: well above the recent average flux.
+        float threshold = fluxMean + thresholdDeviations * fluxDeviation + minThreshold;
+        bool onset = value > threshold && blocksSinceOnset >= refractoryBlocks;
+
+        fluxDeviation += (fabsf(value - fluxMean) - fluxDeviation) * fluxSmoothing;
+        fluxMean += (value - fluxMean) * fluxSmoothing;
+
+        if (onset) {
+            blocksSinceOnset = 0;
+            onsetStrength = value - threshold;
+        }
+
+        // The flux covers every skipped block, so it lands on the first of them
+        // and the rest get nothing. That keeps the history at a steady rate.
+        float strength = max(value - fluxMean, 0.0f);
+        blocks = min(max(blocks, uint32_t(1)), maxCatchUpBlocks);
+
+        for (uint32_t b = 0; b < blocks; b++) {
+            step(b == 0 ? strength : 0, onset && b == 0);
+        }
+
+        return onset;
+    }
+
+    // 0 until there's a steady enough tempo.
+    inline float bpm() const {
+        return isLocked() ? BLOCK_RATE * 60.0f / period : 0;
+    }
+
+    // 0 to 1, where 0 is on the beat.
+    inline float beatPhase() const {
+        return phase;
+    }
+
+    inline uint32_t beatCount() const {
+        return beats;
+    }
+
+    // How far the last onset was over the threshold, in log2 units per bin.
+    inline float lastOnsetStrength() const {
+        return onsetStrength;
+    }
+
+    inline bool isLocked() const {
+        return period > 0 && confidence >= minConfidence;
+    }
+
+private:
+    void step(float strength, bool onset) {
+        blocksSinceOnset = min(blocksSinceOnset + 1, uint32_t(refractoryBlocks));
+
+        history[historyIndex] = strength;
+
+        // Leaky autocorrelation of the onset strengths, one term per lag.
+        energy += strength * strength - energy * correlationLeak;
+        uint16_t bestLag = 0;
+        float bestScore = 0;
+
+        for (uint16_t i = 0; i < lagCount; i++) {
+            float past = history[(historyIndex - (minLag + i)) & (historySize - 1)];
+            correlation[i] += strength * past - correlation[i] * correlationLeak;
+
+            float score = correlation[i] * lagWeights[i];
+
+            if (score > bestScore) {
+                bestScore = score;
+                bestLag = i;
+            }
+        }
+
+        historyIndex = (historyIndex + 1) & (historySize - 1);
+
+        if (bestScore > 0) {
+            // Parabolic interpolation between the neighbouring lags.
+            float lag = minLag + bestLag;
+
+            if (bestLag > 0 && bestLag < lagCount - 1) {
+                float a = correlation[bestLag - 1];
+                float b = correlation[bestLag];
+                float c = correlation[bestLag + 1];
+                float denominator = a - 2 * b + c;
+
+                if (denominator < 0) {
+                    lag += constrain(0.5f * (a - c) / denominator, -0.5f, 0.5f);
+                }
+            }
+
+            period = period > 0 ? period + (lag - period) * periodSmoothing : lag;
+            confidence = energy > 0 ? correlation[bestLag] / energy : 0;
+        }
+
+        if (!isLocked()) {
+            phase = 0;
+            return;
+        }
+
+        phase += 1.0f / period;
+
+        if (phase >= 1) {
+            phase -= 1;
+            beats++;
+        }
+
+        // Pull the phase toward onsets that land near where a beat was expected.
+        if (onset) {
+            float error = phase < 0.5f ? phase : phase - 1;
+            phase -= error * phaseCorrection;
+
+            if (phase < 0) {
+                phase += 1;
+            }
+        }
+    }
+
+private:
+    static constexpr float fluxSmoothing = 1.0f / 64;
+    static constexpr float thresholdDeviations = 1.5f;
+    static constexpr float minThreshold = 0.02f;
+
+    // No more than ~10 onsets a second.
+    static constexpr uint32_t refractoryBlocks = BLOCK_RATE / 10;
+
+    // The autocorrelation forgets over a few seconds.
+    static constexpr float correlationLeak = 1.0f / (BLOCK_RATE * 4);
+    static constexpr float periodSmoothing = 0.05f;
+    static constexpr float minConfidence = 0.15f;
+    static constexpr float phaseCorrection = 0.25f;
+
+    // After a long stall, don't spend forever catching up.
+    static constexpr uint32_t maxCatchUpBlocks = 8;
+
+    uint16_t previousSpectrum[BIN_COUNT];
+    bool hasPreviousSpectrum = false;
+
+    float fluxMean = 0;
+    float fluxDeviation = 0;
+    float onsetStrength = 0;
+    uint32_t blocksSinceOnset = 0;
+
+    float history[historySize];
+    uint16_t historyIndex = 0;
+
+    float lagWeights[lagCount];
+    float correlation[lagCount];
+    float energy = 0;
+
+    float period = 0;
+    float confidence = 0;
+    float phase = 0;
+    uint32_t beats = 0;
+};
@@ -0,0 +1,129 @@
+// Adapted from MIT-licensed code at
+// https://learn.adafruit.com/adafruit-eyelights-led-glasses-and-driver/music-reactive-lights-2
+// by Phil "Paint Your Dragon" Burgess for Adafruit Industries
+
+#pragma once
+
+#include <Arduino.h>
+#include "InterpolatedBands.h"
+
+// Falling bar graph columns on the matrix: each column's top follows its level,
+// and a dot sits on top of it, falling back down under gravity when it drops.
+// Tops are in matrix rows, so 0 is the top row and anything past 4 is off the bottom.
+//
+// New tops arrive once per audio block, stamped with its audio time, and are
+// interpolated (see InterpolatedBands) so the bars move smoothly at any frame rate.
+template<uint8_t COLUMN_COUNT>
+class ColumnBars {
+public:
+    static constexpr uint8_t columnCount = COLUMN_COUNT;
+
+    // The dots fall in steps of this many milliseconds (e.g. as a scene's fixedTimestep()),
+    // so they fall the same however long frames take.
+    static constexpr uint16_t fallStepMs = 5;
+
+public:
+    ColumnBars() {
+        reset();
+    }
+
+    void reset() {
+        // Start off bottom of graph
+        tops.reset(6.0);
+
+        for (int column = 0; column < columnCount; column++) {
+            columns[column].dot = 6.0;
+            columns[column].velocity = 0.0;
+        }
+    }
+
+    // Compute new column tops from one log2 level in Q8 per column (e.g. from a
+    // LogFilterbank), as of timeMs (e.g. AudioFeatures::timeMs). The quietest column
+    // is the bottom of the scale and ceiling is the top (e.g. AudioFeatures::spectrumCeiling),
+    // which keeps the graph 'lively' as ambient volume changes.
+    void analyze(const uint16_t* levels, uint16_t ceiling, uint32_t timeMs) {
+        int32_t lowerLog2 = levels[0];
+        for (int column = 1; column < columnCount; column++) {
+            lowerLog2 = min(lowerLog2, int32_t(levels[column]));
+        }
+
+        // The levels are log2 in Q8; the scale here was tuned for natural log.
+        const float log2ToLn = M_LN2 / 256.0;
+        float scale = 15.0 / max((int32_t(ceiling) - lowerLog2) * log2ToLn, 0.5f);
+
+        float newTops[columnCount];
+
+        for (int column = 0; column < columnCount; column++) {
+            // Mute lower columns slightly and boost higher ones. It graphs better.
+            float tilt = 0.6 + 0.6 * column / max(columnCount - 1, 1);
+            float height = (int32_t(levels[column]) - lowerLog2) * log2ToLn * scale * tilt;
+
+            // Start BELOW matrix and accumulate UP.
+            newTops[column] = 8.0 - height;
+        }
+
+        setTops(newTops, timeMs);
+    }
+
+    // Move the tops along by dt milliseconds of frame time. Call every frame,
+    // whether or not there was anything new to analyze.
+    void update(uint32_t dt) {
+        tops.update(dt);
+    }
+
+    // Move the falling dots along by one fallStepMs step.
+    void fall() {
+        for(int column = 0; column < columnCount; column++) {
+            float columnTop = tops.get(column);
+
+            // Above current falling dot?
+            if(columnTop < columns[column].dot) {
+                // Move dot up
+                columns[column].dot = columnTop - 0.5;
+
+                // and clear out velocity
+                columns[column].velocity = 0.0;
+            } else {
+                const float fdt = fallStepMs * 0.001;
+
+                // Move dot down and accelerate
+                columns[column].dot += columns[column].velocity * fdt;
+                columns[column].velocity += 15.0 * fdt;
+            }
+        }
+    }
+
+    inline float getColumnTop(uint8_t column) const {
+        if (column >= columnCount) {
+            return 0;
+        }
+
+        return tops.get(column);
+    }
+
+    inline float getColumnDot(uint8_t column) const {
+        if (column >= columnCount) {
+            return 0;
+        }
+
+        return columns[column].dot;
+    }
+
+protected:
+    inline void setTops(const float* newTops, uint32_t timeMs) {
+        tops.push(newTops, timeMs);
+    }
+
+private:
+    // Column top positions are filtered to appear less 'twitchy' -- the
+    // last block still has a 40% influence after 32 ms (the original block size).
+    static constexpr float smoothingMs = 34.9;
+    InterpolatedBands<COLUMN_COUNT> tops{smoothingMs};
+
+    struct Column {
+        float dot;
+        float velocity;
+    };
+
+    Column columns[columnCount];
+};
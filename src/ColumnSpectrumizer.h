@@ -5,223 +5,192 @@
 #pragma once
 
 #include <Arduino.h>
-#include <Adafruit_ZeroFFT.h>
-
-template<uint8_t COLUMN_COUNT, uint32_t SAMPLE_COUNT>
-class ColumnSpectrumizer {
-public:
-    static constexpr uint8_t columnCount = COLUMN_COUNT;
-    static constexpr uint32_t sampleCount = SAMPLE_COUNT;
+#include "ConstexprMath.h"
+#include "ColumnBars.h"
+
+namespace ColumnSpectrumizerTables {
+    // Bin weights are stored in Q10.
+    static constexpr uint32_t weightOne = 1024;
+
+    // Which spectrum bins contribute to a column, and where its center
+    // is on a log scale from 0.0 (LOW_BIN) to 1.0 (HIGH_BIN).
+    struct ColumnRange {
+        int32_t firstBin = 0;
+        int32_t lastBin = 0;
+        double mid = 0;
+        double halfWidth = 0;
+    };
 
-public:
-    // Assumes signed 16-bit samples.
-    ColumnSpectrumizer(uint16_t _lowBin, uint16_t _highBin) :
-        lowBin(_lowBin),
-        highBin(_highBin)
-    {
+    template<uint8_t COLUMN_COUNT, uint32_t SAMPLE_COUNT, uint16_t LOW_BIN, uint16_t HIGH_BIN>
+    constexpr ColumnRange columnRange(uint8_t column) {
         // e.g. 8 = 256 bin spectrum
-        uint8_t spectrumBits = (int)log2f((float)sampleCount / 2);
+        double spectrumBits = int32_t(ConstexprMath::log2(SAMPLE_COUNT / 2.0) + 1e-9);
 
         // Scale lowBin and highBin to 0.0 to 1.0 equivalent range in spectrum
-        float lowFrac = log2f((float)lowBin) / (float)spectrumBits;
-        float fracRange = log2((float)highBin) / (float)spectrumBits - lowFrac;
-
-        for (int column = 0; column < columnCount; column++) {
-            // Start off bottom of graph
-            columns[column].top = 6.0;
-            columns[column].dot = 6.0;
-            columns[column].velocity = 0.0;
+        double lowFrac = ConstexprMath::log2(LOW_BIN) / spectrumBits;
+        double fracRange = ConstexprMath::log2(HIGH_BIN) / spectrumBits - lowFrac;
 
-            // Determine the lower and upper frequency range for this column, as
-            // fractions within the scaled 0.0 to 1.0 spectrum range. 0.95 below
-            // creates slight frequency overlap between columns, looks nicer.
-            float lower = lowFrac + fracRange * ((float)column / float(columnCount) * 0.95);
-            float upper = lowFrac + fracRange * ((float)(column + 1) / float(columnCount));
+        // Determine the lower and upper frequency range for this column, as
+        // fractions within the scaled 0.0 to 1.0 spectrum range. 0.95 below
+        // creates slight frequency overlap between columns, looks nicer.
+        double lower = lowFrac + fracRange * (double(column) / COLUMN_COUNT * 0.95);
+        double upper = lowFrac + fracRange * (double(column + 1) / COLUMN_COUNT);
 
-            // Center of lower-to-upper range
-            float mid = (lower + upper) * 0.5;
+        ColumnRange range;
 
-            // 1/2 of lower-to-upper range
-            float halfWidth = (upper - lower) * 0.5 + 1e-2;
+        // Center of lower-to-upper range
+        range.mid = (lower + upper) * 0.5;
 
-            // Map fractions back to spectrum bin indices that contribute to column
-            int firstBin = int(pow(2, (float)spectrumBits * lower) + 1e-4);
-            int lastBin = int(pow(2, (float)spectrumBits * upper) + 1e-4);
+        // 1/2 of lower-to-upper range
+        range.halfWidth = (upper - lower) * 0.5 + 1e-2;
 
-            float totalWeight = 0.0; // Accumulate weight for this bin
-            int numBins = lastBin - firstBin + 1;
-
-            columns[column].firstBin = firstBin;
-            columns[column].numBins = numBins;
-
-            // Allocate space for bin weights for column.
-            // If the allocation fails, guards are in place to make sure we don't crash.
-            float* binWeights = new float[numBins]();
-            columns[column].binWeights = binWeights;
-
-            if (binWeights == nullptr) {
-                continue;
-            }
-            
-            for (int binIndex = firstBin; binIndex <= lastBin; binIndex++) {
-                // Find distance from column's overall center to individual bin's
-                // center, expressed as 0.0 (bin at center) to 1.0 (bin at limit of
-                // lower-to-upper range).
-                float binCenter = log2f((float)binIndex + 0.5) / (float)spectrumBits;
-                float dist = fabs(binCenter - mid) / halfWidth;
-                
-                // Filter out a few math stragglers at either end
-                if (dist < 1.0) { 
-                    // Invert dist so 1.0 is at center
-                    dist = 1.0 - dist;
-                    // Bin weights have a cubic falloff curve within range:                    
-                    float binWeight = (((3.0 - (dist * 2.0)) * dist) * dist);
-                    binWeights[binIndex - firstBin] = binWeight;
-                    totalWeight += binWeight;
-                }
-            }
+        // Map fractions back to spectrum bin indices that contribute to column
+        range.firstBin = int32_t(ConstexprMath::exp2(spectrumBits * lower) + 1e-4);
+        range.lastBin = int32_t(ConstexprMath::exp2(spectrumBits * upper) + 1e-4);
 
-            // Scale bin weights so total is 1.0 for each column, but then mute
-            // lower columns slightly and boost higher columns. It graphs better.
-            for (int i = 0; i < numBins; i++) {
-                binWeights[i] = binWeights[i] / totalWeight * (0.6 + (float)i / float(columnCount) * 2.0);
-            }
-        }
+        return range;
     }
 
-    ~ColumnSpectrumizer() {
-        for (int column = 0; column < columnCount; column++) {
-            delete [] columns[column].binWeights;
-        }
-    }
+    template<uint8_t COLUMN_COUNT, uint32_t SAMPLE_COUNT, uint16_t LOW_BIN, uint16_t HIGH_BIN>
+    constexpr uint32_t weightCount() {
+        uint32_t count = 0;
 
-    void reset() {
-        for (int column = 0; column < columnCount; column++) {
-            // Start off bottom of graph
-            columns[column].top = 6.0;
-            columns[column].dot = 6.0;
-            columns[column].velocity = 0.0;        
+        for (uint8_t column = 0; column < COLUMN_COUNT; column++) {
+            ColumnRange range = columnRange<COLUMN_COUNT, SAMPLE_COUNT, LOW_BIN, HIGH_BIN>(column);
+            count += range.lastBin - range.firstBin + 1;
         }
+
+        return count;
     }
 
-    void update(const int16_t* sampleBuffer, uint32_t dt) {
-        int16_t fftBuffer[sampleCount];
-        memcpy(fftBuffer, sampleBuffer, sampleCount * sizeof(fftBuffer[0]));
+    // The bins each column is made of, and how much each contributes,
+    // built at compile time and kept in flash.
+    template<uint8_t COLUMN_COUNT, uint32_t SAMPLE_COUNT, uint16_t LOW_BIN, uint16_t HIGH_BIN>
+    struct Tables {
+        static constexpr uint32_t weightCount = ColumnSpectrumizerTables::weightCount<COLUMN_COUNT, SAMPLE_COUNT, LOW_BIN, HIGH_BIN>();
+
+        struct Column {
+            uint16_t firstBin;
+            uint16_t binCount;
+            uint16_t firstWeight;
+        };
+
+        Column columns[COLUMN_COUNT];
+        uint16_t weights[weightCount];
+
+        // Largest weight, before quantizing, so it can be checked to fit.
+        double maxWeight;
+
+        constexpr Tables() : columns(), weights(), maxWeight(0) {
+            const double spectrumBits = int32_t(ConstexprMath::log2(SAMPLE_COUNT / 2.0) + 1e-9);
+            uint16_t nextWeight = 0;
+
+            for (uint8_t column = 0; column < COLUMN_COUNT; column++) {
+                ColumnRange range = columnRange<COLUMN_COUNT, SAMPLE_COUNT, LOW_BIN, HIGH_BIN>(column);
+                uint16_t binCount = range.lastBin - range.firstBin + 1;
+
+                columns[column].firstBin = range.firstBin;
+                columns[column].binCount = binCount;
+                columns[column].firstWeight = nextWeight;
+
+                // Accumulate weight for this bin
+                double binWeights[HIGH_BIN + 1] = {};
+                double totalWeight = 0.0;
+
+                for (int32_t binIndex = range.firstBin; binIndex <= range.lastBin; binIndex++) {
+                    // Find distance from column's overall center to individual bin's
+                    // center, expressed as 0.0 (bin at center) to 1.0 (bin at limit of
+                    // lower-to-upper range).
+                    double binCenter = ConstexprMath::log2(binIndex + 0.5) / spectrumBits;
+                    double dist = ConstexprMath::abs(binCenter - range.mid) / range.halfWidth;
+
+                    // Filter out a few math stragglers at either end
+                    if (dist < 1.0) {
+                        // Invert dist so 1.0 is at center
+                        dist = 1.0 - dist;
+                        // Bin weights have a cubic falloff curve within range:
+                        double binWeight = (((3.0 - (dist * 2.0)) * dist) * dist);
+                        binWeights[binIndex - range.firstBin] = binWeight;
+                        totalWeight += binWeight;
+                    }
+                }
 
-        // Perform the FFT operation on our buffer.
-        ZeroFFT(fftBuffer, sampleCount);
+                // Scale bin weights so total is 1.0 for each column, but then mute
+                // lower columns slightly and boost higher columns. It graphs better.
+                for (uint16_t i = 0; i < binCount; i++) {
+                    double w = (totalWeight > 0) ? binWeights[i] / totalWeight * (0.6 + double(i) / COLUMN_COUNT * 2.0) : 0;
+                    maxWeight = (w > maxWeight) ? w : maxWeight;
+                    weights[nextWeight++] = uint16_t(w * weightOne + 0.5);
+                }
+            }
+        }
+    };
+}
 
-        // Convert FFT output to spectrum. log(y) looks better than raw data.
-        // Only lowBin to highBin elements are needed.
-        uint32_t spectrumSize = sampleCount / 2;
-        float spectrum[spectrumSize];
+// Turns spectra (e.g. AudioFeatures::spectrum) from an FFT of SAMPLE_COUNT
+// samples into falling bar graph columns.
+template<uint8_t COLUMN_COUNT, uint32_t SAMPLE_COUNT, uint16_t LOW_BIN, uint16_t HIGH_BIN>
+class ColumnSpectrumizer: public ColumnBars<COLUMN_COUNT> {
+public:
+    using ColumnBars<COLUMN_COUNT>::columnCount;
+    static constexpr uint32_t sampleCount = SAMPLE_COUNT;
+    static constexpr uint16_t lowBin = LOW_BIN;
+    static constexpr uint16_t highBin = HIGH_BIN;
 
-        for(int i = lowBin; i <= highBin; i++) {
-            spectrum[i] = (fftBuffer[i] > 0) ? log((float)fftBuffer[i]) : 0.0;
-        }
+    static_assert(LOW_BIN > 0 && LOW_BIN < HIGH_BIN && HIGH_BIN < SAMPLE_COUNT / 2, "bins must be within the spectrum");
 
-        // Find min & max range of spectrum bin values, with limits.
-        float lower = spectrum[lowBin], upper = spectrum[lowBin];
+public:
+    // Compute new column tops from a spectrum of log2 bin magnitudes in Q8
+    // (log(y) looks better than raw data). Only lowBin to highBin are used.
+    // ceiling is the top of the scale, also log2 in Q8 (e.g. AudioFeatures::spectrumCeiling),
+    // which keeps the graph 'lively' as ambient volume changes. timeMs is the
+    // spectrum's audio time (e.g. AudioFeatures::timeMs).
+    void analyze(const uint16_t* spectrum, uint16_t ceiling, uint32_t timeMs) {
+        // Find the bottom of the range of spectrum bin values.
+        int32_t lowerLog2 = spectrum[lowBin];
         for (int i = lowBin + 1; i <= highBin; i++) {
-            if (spectrum[i] < lower) {
-                lower = spectrum[i];
-            }
-
-            if (spectrum[i] > upper) {
-                upper = spectrum[i];
+            if (spectrum[i] < lowerLog2) {
+                lowerLog2 = spectrum[i];
             }
         }
-        if (upper < 2.5) { 
-            upper = 2.5;
-        }
 
-        // Adjust dynamic level to current spectrum output, keeps the graph
-        // 'lively' as ambient volume changes. Sparkle but don't saturate.
-        if (upper > dynamicLevel) {
-            // Got louder. Move level up quickly but allow initial "bump."
-            dynamicLevel = dynamicLevel * 0.5 + upper * 0.5;
-        } else {
-            // Got quieter. Ease level down, else too many bumps.
-            dynamicLevel = dynamicLevel * 0.75 + lower * 0.25;
-        }
+        // The spectrum is log2 in Q8; the levels here were tuned for natural log.
+        const float log2ToLn = M_LN2 / 256.0;
+        float lower = lowerLog2 * log2ToLn;
+        float upper = ceiling * log2ToLn;
 
         // Apply vertical scale to spectrum data. Results may exceed
         // matrix height...that's OK, adds impact!
-        float scale = 15.0 / (dynamicLevel - lower);
-        for (int i = lowBin; i <= highBin; i++) {
-            spectrum[i] = (spectrum[i] - lower) * scale;
-        }
-
-        // Set up each column.
-        for(int column = 0; column < columnCount; column++) {
-            float* binWeights = columns[column].binWeights;
-            
-            if (binWeights == nullptr) {
-                columns[column].top = 0;
-                columns[column].dot = column[columns].top - 0.5;
-                columns[column].velocity = 0.0;
-                continue;
-            }
-
-            int firstBin = columns[column].firstBin;
+        float scale = 15.0 / max(upper - lower, 0.5f);
 
-            // Start BELOW matrix and accumulate bin weights UP, saves math.
-            float columnTop = 8.0;
-            for (int binOffset = 0; binOffset < columns[column].numBins; binOffset++) {
-                columnTop -= spectrum[firstBin + binOffset] * binWeights[binOffset];
-            }
-
-            // Column top positions are filtered to appear less 'twitchy' --
-            // last data still has a 40% influence on current positions.
-            columnTop = (columnTop * 0.6) +  (columns[column].top * 0.4);
-            columns[column].top = columnTop;
+        // The weighted sums are in Q8 log2 times Q10 weights,
+        // so convert back all at once for each column.
+        float columnScale = scale * log2ToLn / ColumnSpectrumizerTables::weightOne;
 
-            // Above current falling dot?
-            if(columnTop < columns[column].dot) {
-                // Move dot up
-                columns[column].dot = columnTop - 0.5;
+        // Set up each column.
+        float tops[columnCount];
 
-                // and clear out velocity
-                columns[column].velocity = 0.0;
-            } else {
-                float fdt = dt * 0.001;
+        for(int column = 0; column < columnCount; column++) {
+            const typename Tables::Column& layout = tables.columns[column];
+            const uint16_t* bins = &spectrum[layout.firstBin];
+            const uint16_t* weights = &tables.weights[layout.firstWeight];
 
-                // Move dot down and accelerate
-                columns[column].dot += columns[column].velocity * fdt;
-                columns[column].velocity += 15.0 * fdt;
+            int32_t sum = 0;
+            for (int binOffset = 0; binOffset < layout.binCount; binOffset++) {
+                sum += (int32_t(bins[binOffset]) - lowerLog2) * weights[binOffset];
             }
-        }    
-    }
 
-    inline float getColumnTop(uint8_t column) const {
-        if (column >= columnCount) {
-            return 0;
+            // Start BELOW matrix and accumulate bin weights UP, saves math.
+            tops[column] = 8.0 - sum * columnScale;
         }
 
-        return columns[column].top;
+        this->setTops(tops, timeMs);
     }
 
-    inline float getColumnDot(uint8_t column) const {
-        if (column >= columnCount) {
-            return 0;
-        }
-
-        return columns[column].dot;
-    }    
-
 private:
-    struct Column {
-        int firstBin;
-        int numBins;
-        float* binWeights;
-        float top;
-        float dot;
-        float velocity;
-    };
-
-    Column columns[columnCount];
-    float dynamicLevel = 10.0;
+    typedef ColumnSpectrumizerTables::Tables<COLUMN_COUNT, SAMPLE_COUNT, LOW_BIN, HIGH_BIN> Tables;
+    static constexpr Tables tables{};
 
-    const int32_t lowBin;
-    const int32_t highBin;    
-};
\ No newline at end of file
+    // Keeps the weighted sums comfortably inside 32 bits.
+    static_assert(tables.maxWeight < 16.0, "bin weights don't fit in Q10");
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Just enough math to build lookup tables at compile time. These are slow,
+// so only ever use them in constexpr initializers.
+namespace ConstexprMath {
+    constexpr double pi = 3.14159265358979323846;
+    constexpr double ln2 = 0.69314718055994530942;
+
+    constexpr double abs(double x) {
+        return x < 0 ? -x : x;
+    }
+
+    constexpr double floor(double x) {
+        double i = double(int64_t(x));
+        return (i > x) ? i - 1.0 : i;
+    }
+
+    constexpr double sine(double x) {
+        while (x > pi) {
+            x -= 2.0 * pi;
+        }
+
+        while (x < -pi) {
+            x += 2.0 * pi;
+        }
+
+        double term = x;
+        double sum = x;
+
+        for (int i = 1; i < 12; i++) {
+            term *= -x * x / ((2.0 * i) * (2.0 * i + 1.0));
+            sum += term;
+        }
+
+        return sum;
+    }
+
+    constexpr double cosine(double x) {
+        return sine(x + pi / 2.0);
+    }
+
+    // x must be greater than zero.
+    constexpr double log2(double x) {
+        int32_t exponent = 0;
+
+        while (x >= 2.0) {
+            x *= 0.5;
+            exponent++;
+        }
+
+        while (x < 1.0) {
+            x *= 2.0;
+            exponent--;
+        }
+
+        // ln(x) = 2 * atanh((x - 1) / (x + 1)), which converges quickly for x in [1, 2).
+        double y = (x - 1.0) / (x + 1.0);
+        double term = y;
+        double sum = 0;
+
+        for (int k = 0; k < 20; k++) {
+            sum += term / (2 * k + 1);
+            term *= y * y;
+        }
+
+        return exponent + 2.0 * sum / ln2;
+    }
+
+    constexpr double exp2(double x) {
+        double whole = floor(x);
+        double f = (x - whole) * ln2;
+
+        double term = 1.0;
+        double sum = 1.0;
+
+        for (int k = 1; k < 20; k++) {
+            term *= f / k;
+            sum += term;
+        }
+
+        for (; whole > 0; whole -= 1.0) {
+            sum *= 2.0;
+        }
+
+        for (; whole < 0; whole += 1.0) {
+            sum *= 0.5;
+        }
+
+        return sum;
+    }
+}
@@ -1,25 +1,30 @@
 #pragma once
 
-#include <Adafruit_IS31FL3741.h>
 #include <Adafruit_LIS3DH.h>
+#include "Glasses.h"
 #include "Gamepad.h"
 #include "SoftGamepad.h"
 #include "PdmRecorder.h"
+#include "AudioAnalyzer.h"
+#include "ModulationMatrix.h"
 #include "Settings.h"
 
 typedef Adafruit_LIS3DH Accel;
-typedef Adafruit_EyeLights_buffered Glasses;
 
 struct Device {
     Device(Accel& _accel, 
            Glasses& _glasses, 
            PdmRecorder& _pdmRecorder, 
+           AudioAnalyzer& _audioAnalyzer,
+           ModulationMatrix& _modulation,
            Gamepad& _gamepad, 
            SoftGamepad& _softGamepad,
            Settings& _settings) : 
         accel(_accel),
         glasses(_glasses), 
         pdmRecorder(_pdmRecorder),
+        audioAnalyzer(_audioAnalyzer),
+        modulation(_modulation),
         gamepad(_gamepad),
         softGamepad(_softGamepad),
         settings(_settings)
@@ -30,6 +35,8 @@ struct Device {
     Accel& accel;
     Glasses& glasses;
     PdmRecorder& pdmRecorder;
+    AudioAnalyzer& audioAnalyzer;
+    ModulationMatrix& modulation;
     Gamepad& gamepad;
     SoftGamepad& softGamepad;
     Settings& settings;
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+// A bounded queue that any number of tasks (or interrupts) can push to while one
+// task pops, without locks. Each slot has a sequence number that says whose turn
+// it is: a producer claims a slot by moving the tail along, fills it, and then
+// hands it over by bumping its sequence; the consumer takes it and hands it back
+// a lap later. Nothing ever waits; push() fails if the queue is full, and pop()
+// fails if the next event hasn't been finished yet.
+//
+// CAPACITY must be a power of two.
+template<typename T, uint32_t CAPACITY>
+class EventQueue {
+public:
+    static constexpr uint32_t capacity = CAPACITY;
+    static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+public:
+    EventQueue() {
+        for (uint32_t i = 0; i < capacity; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Safe from any task. Returns false, and counts the event as dropped, if the queue is full.
+    bool push(const T& value) {
+        uint32_t position = tail.load(std::memory_order_relaxed);
+
+        for (;;) {
+            Slot& slot = slots[position & mask];
+            uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+            int32_t difference = int32_t(sequence - position);
+
+            if (difference == 0) {
+                // The slot is free on this lap; try to claim it.
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = value;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0) {
+                // The consumer hasn't taken the last lap's event yet.
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else {
+                // Another producer got there first.
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Only from the one consuming task.
+    bool pop(T& value) {
+        Slot& slot = slots[head & mask];
+        uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+
+        if (sequence != head + 1) {
+            return false;
+        }
+
+        value = slot.value;
+        slot.sequence.store(head + capacity, std::memory_order_release);
+        head++;
+        return true;
+    }
+
+    // How many events have been dropped because the queue was full.
+    inline uint32_t droppedCount() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    // For events a producer had to drop before they got this far.
+    inline void countDropped() {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr uint32_t mask = capacity - 1;
+
+    struct Slot {
+        std::atomic<uint32_t> sequence{0};
+        T value;
+    };
+
+    Slot slots[capacity];
+    std::atomic<uint32_t> tail{0};
+    uint32_t head = 0;
+    std::atomic<uint32_t> dropped{0};
+};
@@ -26,6 +26,12 @@ void FSM::update(uint32_t dt) {
     }
 }
 
+void FSM::fixedUpdate(uint32_t dt) {
+    if (currentState != nullptr) {
+        currentState->fixedUpdate(dt);
+    }
+}
+
 void FSM::transition() {
     if (currentState != nullptr) {
         FSMState* nextState = currentState->transition();
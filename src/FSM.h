@@ -10,6 +10,7 @@ public:
     
     void gotoState(FSMState* s);
     void update(uint32_t dt);
+    void fixedUpdate(uint32_t dt);
     void transition();
 
 private:
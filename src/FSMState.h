@@ -9,6 +9,7 @@ public:
 
     virtual void enter() {}
     virtual void update(uint32_t dt) {}
+    virtual void fixedUpdate(uint32_t dt) {}
     virtual FSMState* transition() { return nullptr; }
     virtual void exit() {}
 };
\ No newline at end of file
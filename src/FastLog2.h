@@ -0,0 +1,21 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Integer log2, in Q8 fixed point (i.e. 256 = 1.0), good to about 0.005.
+// Returns 0 for 0, since that's what the spectrum code wants for an empty bin.
+inline uint16_t fastLog2Q8(uint64_t x) {
+    if (x == 0) {
+        return 0;
+    }
+
+    int32_t msb = 63 - __builtin_clzll(x);
+
+    // The 8 bits below the leading one are the fraction.
+    uint32_t f = (msb >= 8) ? uint32_t(x >> (msb - 8)) & 0xFF : uint32_t(x << (8 - msb)) & 0xFF;
+
+    // log2(1 + f) ~= f + 0.34 * f * (1 - f)
+    uint32_t correction = (f * (256 - f) * 87) >> 16;
+
+    return (msb << 8) + f + correction;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <Arduino.h>
+#include "ZeroFftBackend.h"
+#include "Q15RealFft.h"
+#include "CycleCounter.h"
+
+// Runs the ZeroFFT and Q15RealFft backends on the same samples, for comparing
+// how long each takes and how closely their spectra agree. Needs CycleCounter::begin().
+template<uint32_t SAMPLE_COUNT>
+class FftBenchmark {
+public:
+    struct Result {
+        uint32_t zeroFftCycles = 0;
+        uint32_t q15Cycles = 0;
+
+        // Largest difference between the two, in log2 (i.e. 1.0 = a factor of 2).
+        float maxLog2Difference = 0;
+    };
+
+    Result run(const int16_t* samples, uint16_t lowBin, uint16_t highBin) {
+        Result result;
+
+        uint32_t start = CycleCounter::now();
+        zeroFft.log2Magnitudes(samples, lowBin, highBin, zeroFftSpectrum);
+        result.zeroFftCycles = CycleCounter::since(start);
+
+        start = CycleCounter::now();
+        q15Fft.log2Magnitudes(samples, lowBin, highBin, q15Spectrum);
+        result.q15Cycles = CycleCounter::since(start);
+
+        int32_t maxDifference = 0;
+
+        for (uint16_t i = lowBin; i <= highBin; i++) {
+            maxDifference = max(maxDifference, abs(int32_t(zeroFftSpectrum[i]) - int32_t(q15Spectrum[i])));
+        }
+
+        result.maxLog2Difference = maxDifference / 256.0;
+        return result;
+    }
+
+private:
+    ZeroFftBackend<SAMPLE_COUNT> zeroFft;
+    Q15RealFft<SAMPLE_COUNT> q15Fft;
+
+    uint16_t zeroFftSpectrum[SAMPLE_COUNT / 2];
+    uint16_t q15Spectrum[SAMPLE_COUNT / 2];
+};
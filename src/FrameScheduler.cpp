@@ -0,0 +1,49 @@
+#include "FrameScheduler.h"
+
+void FrameScheduler::setScene(Scene* s, uint32_t now) {
+    scene = s;
+
+    uint16_t frameRate = (scene != nullptr) ? scene->frameRate() : defaultFrameRate;
+    interval = 1000 / max(frameRate, 1);
+
+    reset(now);
+}
+
+void FrameScheduler::reset(uint32_t now) {
+    lastFrameTime = now;
+    accumulator = 0;
+}
+
+bool FrameScheduler::run(uint32_t now) {
+    uint32_t dt = now - lastFrameTime;
+    lastFrameTime = now;
+
+    if (scene == nullptr) {
+        return false;
+    }
+
+    scene->update(dt);
+
+    uint16_t timestep = scene->fixedTimestep();
+
+    if (timestep > 0) {
+        accumulator += dt;
+
+        for (uint8_t i = 0; i < maxStepsPerFrame && accumulator >= timestep; i++) {
+            scene->fixedUpdate(timestep);
+            accumulator -= timestep;
+        }
+
+        // Drop whatever we couldn't catch up on.
+        accumulator = min(accumulator, uint32_t(timestep - 1));
+    }
+
+    // Nothing changed, so the glasses are already showing this frame.
+    if (scene->needsRender()) {
+        scene->renderNeeded = false;
+        scene->draw();
+        return true;
+    }
+
+    return false;
+}
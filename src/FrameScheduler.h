@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Arduino.h>
+#include "Scene.h"
+
+// Runs the current scene's frames. Each frame, the scene is updated once,
+// stepped at its fixed timestep (if it has one), and then drawn once if it
+// was invalidated. The frames are paced by whoever calls run(), e.g. a
+// TaskScheduler task with a period of frameInterval().
+class FrameScheduler {
+public:
+    FrameScheduler() = default;
+
+    void setScene(Scene* s, uint32_t now);
+
+    // Start timing over, e.g. after something blocked for a long time,
+    // so the scene doesn't see a huge dt.
+    void reset(uint32_t now);
+
+    // How many milliseconds apart the scene wants its frames.
+    inline uint32_t frameInterval() const {
+        return interval;
+    }
+
+    // Update (and draw, if needed) the scene. Returns true if it was drawn.
+    bool run(uint32_t now);
+
+private:
+    // Don't spiral trying to catch up after a long stall.
+    static constexpr uint8_t maxStepsPerFrame = 5;
+
+    // Used when there's no scene.
+    static constexpr uint16_t defaultFrameRate = 60;
+
+    Scene* scene = nullptr;
+
+    uint32_t interval = 1000 / defaultFrameRate;
+    uint32_t lastFrameTime = 0;
+    uint32_t accumulator = 0;
+};
@@ -0,0 +1,308 @@
+#include "Glasses.h"
+#include <nrf_sdm.h>
+#include <nrf_soc.h>
+
+namespace {
+    // The SoftDevice keeps EGU1, 2, 4 and 5 for itself.
+    NRF_EGU_Type* const egu = NRF_EGU3;
+    const IRQn_Type eguIrq = SWI3_EGU3_IRQn;
+
+    // Low enough to call FreeRTOS from (configMAX_SYSCALL_INTERRUPT_PRIORITY is 2).
+    const uint8_t eguIrqPriority = 3;
+
+    // PPI channels 17 and up belong to the SoftDevice.
+    const uint8_t stoppedChannel = 14;
+    const uint8_t errorChannel = 15;
+
+    Glasses* transferringGlasses = nullptr;
+
+    NRF_TWIM_Type* twimFor(TwoWire* wire) {
+        if (wire == &Wire) {
+            return NRF_TWIM0;
+        }
+
+        #if WIRE_INTERFACES_COUNT > 1
+        if (wire == &Wire1) {
+            return NRF_TWIM1;
+        }
+        #endif
+
+        return nullptr;
+    }
+
+    // Once the SoftDevice is up, the PPI is only ours through its API.
+    void connectPpi(uint8_t channel, volatile uint32_t* event, volatile uint32_t* task) {
+        uint8_t softDeviceEnabled = 0;
+        sd_softdevice_is_enabled(&softDeviceEnabled);
+
+        if (softDeviceEnabled) {
+            sd_ppi_channel_assign(channel, event, task);
+            sd_ppi_channel_enable_set(1UL << channel);
+        }
+        else {
+            NRF_PPI->CH[channel].EEP = (uint32_t)event;
+            NRF_PPI->CH[channel].TEP = (uint32_t)task;
+            NRF_PPI->CHENSET = 1UL << channel;
+        }
+    }
+}
+
+extern "C" void SWI3_EGU3_IRQHandler(void) {
+    if (egu->EVENTS_TRIGGERED[0]) {
+        egu->EVENTS_TRIGGERED[0] = 0;
+
+        if (transferringGlasses != nullptr) {
+            transferringGlasses->transferStopped();
+        }
+    }
+}
+
+bool Glasses::begin(uint8_t addr, TwoWire* theWire) {
+    waitForTransfer();
+    invalidate();
+
+    twim = twimFor(theWire);
+
+    if (twim == nullptr) {
+        return false;
+    }
+
+    if (!Adafruit_EyeLights_buffered::begin(addr, theWire)) {
+        return false;
+    }
+
+    GlassesLayout::build(*this);
+
+    // Every time the TWIM stops, the EGU interrupts to start the next step. The TWIM
+    // doesn't stop by itself on an error (e.g. a NACK), so errors stop it too.
+    transferringGlasses = this;
+    connectPpi(stoppedChannel, &twim->EVENTS_STOPPED, &egu->TASKS_TRIGGER[0]);
+    connectPpi(errorChannel, &twim->EVENTS_ERROR, &twim->TASKS_STOP);
+
+    egu->EVENTS_TRIGGERED[0] = 0;
+    egu->INTENSET = EGU_INTENSET_TRIGGERED0_Msk;
+    NVIC_ClearPendingIRQ(eguIrq);
+    NVIC_SetPriority(eguIrq, eguIrqPriority);
+    NVIC_EnableIRQ(eguIrq);
+
+    return true;
+}
+
+
+void Glasses::show() {
+    if (_i2c_dev == nullptr) {
+        return;
+    }
+
+    // Don't touch the front buffer until the DMA is done reading it.
+    waitForTransfer();
+
+    const uint8_t* frame = getBuffer();
+    runCount = 0;
+
+    if (!shadowValid) {
+        // Nothing we can diff against, send everything.
+        addRun(0, page0RegisterCount);
+        addRun(page0RegisterCount, pwmRegisterCount);
+        shadowValid = true;
+    }
+    else {
+        uint16_t i = 0;
+
+        while (i < pwmRegisterCount) {
+            if (frame[i] == shadow[1 + i]) {
+                i++;
+                continue;
+            }
+
+            // Runs can't cross the page boundary.
+            const uint16_t pageEnd = (i < page0RegisterCount) ? page0RegisterCount : pwmRegisterCount;
+
+            uint16_t start = i;
+            uint16_t end = i + 1;
+            uint8_t gap = 0;
+
+            // Extend the run until we see more than coalesceGap unchanged registers in a row.
+            for (uint16_t j = end; j < pageEnd; j++) {
+                if (frame[j] != shadow[1 + j]) {
+                    end = j + 1;
+                    gap = 0;
+                }
+                else if (++gap > coalesceGap) {
+                    break;
+                }
+            }
+
+            addRun(start, end);
+            i = end;
+        }
+    }
+
+    if (runCount == 0) {
+        return;
+    }
+
+    // Swap: the changed registers become the front buffer the DMA reads from.
+    for (uint8_t r = 0; r < runCount; r++) {
+        const Run& run = runs[r];
+        memcpy(&shadow[1 + run.start], &frame[run.start], run.end - run.start);
+    }
+
+    runIndex = 0;
+    currentPage = -1;
+    step = runStep;
+    transferring.store(true, std::memory_order_release);
+    startStep();
+}
+
+void Glasses::transferStopped() {
+    // Wire's own transactions on the shared bus stop the TWIM too.
+    if (!transferring.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    bool failed = twim->EVENTS_ERROR;
+    finishStep();
+
+    if (failed) {
+        // Most likely a NACK. We don't know which registers made it,
+        // so resend everything next frame.
+        invalidate();
+    }
+    else {
+        if (step == runStep) {
+            runIndex++;
+        }
+
+        if (runIndex < runCount) {
+            startStep();
+            return;
+        }
+    }
+
+    transferring.store(false, std::memory_order_release);
+
+    TaskHandle_t task = waitingTask.load(std::memory_order_acquire);
+
+    if (task != nullptr) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(task, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+void Glasses::waitForTransfer() {
+    if (!isTransferring()) {
+        return;
+    }
+
+    // Set before looking again, so a transfer that finishes in between still wakes us.
+    waitingTask.store(xTaskGetCurrentTaskHandle(), std::memory_order_release);
+    uint32_t startTime = millis();
+
+    while (isTransferring()) {
+        uint32_t waited = millis() - startTime;
+
+        if (waited >= transferTimeoutMs) {
+            abortTransfer();
+            break;
+        }
+
+        ulTaskNotifyTake(pdTRUE, max(ms2tick(transferTimeoutMs - waited), TickType_t(1)));
+    }
+
+    waitingTask.store(nullptr, std::memory_order_release);
+}
+
+void Glasses::abortTransfer() {
+    // Keep the interrupt out of it while the TWIM is reset.
+    NVIC_DisableIRQ(eguIrq);
+
+    if (isTransferring()) {
+        // Most likely a device holding SDA low. Turning the TWIM off and on
+        // again gets it out of whatever it was stuck in.
+        twim->ENABLE = TWIM_ENABLE_ENABLE_Disabled << TWIM_ENABLE_ENABLE_Pos;
+        twim->ENABLE = TWIM_ENABLE_ENABLE_Enabled << TWIM_ENABLE_ENABLE_Pos;
+
+        finishStep();
+        invalidate();
+        transferring.store(false, std::memory_order_release);
+    }
+
+    egu->EVENTS_TRIGGERED[0] = 0;
+    NVIC_ClearPendingIRQ(eguIrq);
+    NVIC_EnableIRQ(eguIrq);
+}
+
+void Glasses::addRun(uint16_t start, uint16_t end) {
+    // Out of runs; stretch the last one, resending a few unchanged registers.
+    // The last slot is kept free for a run on the second page.
+    if (runCount >= maxRunCount - 1) {
+        Run& last = runs[runCount - 1];
+        bool samePage = (last.start < page0RegisterCount) == (start < page0RegisterCount);
+
+        if (samePage || runCount == maxRunCount) {
+            last.end = end;
+            return;
+        }
+    }
+
+    runs[runCount].start = start;
+    runs[runCount].end = end;
+    runCount++;
+}
+
+void Glasses::startStep() {
+    const Run& run = runs[runIndex];
+    int8_t page = (run.start < page0RegisterCount) ? 0 : 1;
+    uint8_t* txd;
+    uint16_t length;
+
+    // Page selects go out the same way as the runs, a couple of bytes each,
+    // so nothing in here ever waits on the bus.
+    if (page != currentPage) {
+        if (step != unlockStep) {
+            command[0] = commandRegisterLock;
+            command[1] = commandRegisterUnlock;
+            step = unlockStep;
+        }
+        else {
+            command[0] = commandRegister;
+            command[1] = page;
+            currentPage = page;
+            step = pageStep;
+        }
+
+        txd = command;
+        length = sizeof(command);
+    }
+    else {
+        // Borrow the byte before the run to hold the register address.
+        txd = &shadow[run.start];
+        savedByte = *txd;
+        *txd = run.start - (page * page0RegisterCount);
+        length = 1 + run.end - run.start;
+        step = runStep;
+    }
+
+    twim->ADDRESS = _i2c_dev->address();
+    twim->SHORTS = TWIM_SHORTS_LASTTX_STOP_Msk;
+    twim->TXD.PTR = (uint32_t)txd;
+    twim->TXD.MAXCNT = length;
+    twim->EVENTS_STOPPED = 0;
+    twim->EVENTS_ERROR = 0;
+    twim->EVENTS_LASTTX = 0;
+    twim->TASKS_STARTTX = 1;
+}
+
+void Glasses::finishStep() {
+    twim->EVENTS_STOPPED = 0;
+    twim->EVENTS_ERROR = 0;
+    twim->EVENTS_LASTTX = 0;
+    twim->ERRORSRC = twim->ERRORSRC;
+    twim->SHORTS = 0;
+
+    if (step == runStep) {
+        shadow[runs[runIndex].start] = savedByte;
+    }
+}
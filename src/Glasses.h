@@ -0,0 +1,188 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Adafruit_IS31FL3741.h>
+#include <atomic>
+#include "Color.h"
+#include "GlassesLayout.h"
+#include "GlassesBuffer.h"
+#include "OutputStage.h"
+
+// Adafruit_EyeLights_buffered with a delta flush and a non-blocking transfer.
+//
+// show() diffs the frame against a shadow copy of the PWM registers that were
+// last sent to the IS31FL3741, copies the changed runs into the shadow, and
+// hands them to the TWIM peripheral's EasyDMA one run at a time. The shadow is
+// the front buffer being transferred, and the library's LED buffer is the back
+// buffer scenes draw the next frame into while the transfer is in progress.
+//
+// Wire owns the TWIM's own interrupt, so the PPI routes the TWIM's STOPPED event
+// to an EGU instead, whose interrupt starts the next run (page selects included).
+// The transfer moves along by itself, and nobody has to wait for it until they
+// want the bus, or the front buffer, back.
+//
+// Runs separated by a few unchanged registers are coalesced into a single burst,
+// since that's cheaper than the overhead of starting a new I2C transaction.
+//
+// Pixels can also be written straight into the LED buffer through the
+// GlassesLayout tables, skipping Adafruit_GFX's virtual dispatch, bounds
+// checks and 565 packing, or a whole frame of linear colors can be loaded in
+// register order through the output stage, which applies brightness and gamma.
+//
+// Everything else on the I2C bus (accelerometer, EEPROM) shares the TWIM
+// peripheral with us, so call waitForTransfer() before using the bus.
+//
+// Only one Glasses can be transferring, since there's only the one EGU interrupt.
+
+extern "C" void SWI3_EGU3_IRQHandler(void);
+
+class Glasses : public Adafruit_EyeLights_buffered {
+public:
+    static constexpr uint16_t pwmRegisterCount = GlassesLayout::registerCount;
+
+public:
+    Glasses(bool withCanvas = false) : Adafruit_EyeLights_buffered(withCanvas) {}
+
+    // theWire must be Wire (TWIM0) or Wire1 (TWIM1), since the transfer
+    // drives the TWIM behind it directly. Returns false for anything else.
+    bool begin(uint8_t addr = IS3741_ADDR_DEFAULT, TwoWire* theWire = &Wire);
+
+    // Start sending the registers that changed since the last call.
+    // Waits for the previous frame to finish transferring first.
+    void show();
+
+    inline bool isTransferring() const {
+        return transferring.load(std::memory_order_acquire);
+    }
+
+    // Completion fence: returns once the frame in flight has been sent
+    // and the I2C bus is free for other devices. The calling task sleeps
+    // until then. If the bus is stuck, it gives up after transferTimeoutMs,
+    // resets the TWIM and resends the whole frame next time.
+    void waitForTransfer();
+
+    // Direct pixel access. Colors are written as-is (no 565 packing or gamma).
+
+    inline void setMatrixPixel(uint16_t index, const Color::RGB& c) {
+        GlassesLayout::writePixel(getBuffer(), GlassesLayout::matrixPixel(index), c);
+    }
+
+    inline void setMatrixPixel(uint16_t x, uint16_t y, const Color::RGB& c) {
+        if (x >= GlassesLayout::matrixWidth || y >= GlassesLayout::matrixHeight) {
+            return;
+        }
+
+        setMatrixPixel(y * GlassesLayout::matrixWidth + x, c);
+    }
+
+    inline void setLeftRingPixel(uint8_t index, const Color::RGB& c) {
+        GlassesLayout::writePixel(getBuffer(), GlassesLayout::leftRingPixel(index), c);
+    }
+
+    inline void setRightRingPixel(uint8_t index, const Color::RGB& c) {
+        GlassesLayout::writePixel(getBuffer(), GlassesLayout::rightRingPixel(index), c);
+    }
+
+    // Replace the whole LED buffer with a frame, passed through the output stage.
+    // The frame is remembered for reload(), so it needs to outlive the next
+    // forgetLoadedFrame() (e.g. a scene member).
+    void load(const GlassesBuffer& frame) {
+        loadedFrame = &frame;
+        outputStage.apply(frame.getRegisters(), getBuffer(), pwmRegisterCount);
+    }
+
+    // Load the last loaded frame again, e.g. after the output stage's brightness
+    // changed, without drawing it again. Returns false if there isn't one.
+    bool reload() {
+        if (loadedFrame == nullptr) {
+            return false;
+        }
+
+        load(*loadedFrame);
+        return true;
+    }
+
+    // Call before the loaded frame goes away, e.g. when its scene exits.
+    void forgetLoadedFrame() {
+        loadedFrame = nullptr;
+    }
+
+    inline bool hasLoadedFrame() const {
+        return loadedFrame != nullptr;
+    }
+
+    inline OutputStage& output() {
+        return outputStage;
+    }
+
+    // Force the next call to show() to send the entire frame, e.g. if the
+    // controller's PWM registers were written to behind our back.
+    void invalidate() {
+        shadowValid = false;
+    }
+
+private:
+    struct Run {
+        uint16_t start;
+        uint16_t end;
+    };
+
+    // What the TWIM is sending.
+    enum Step: uint8_t {
+        unlockStep,
+        pageStep,
+        runStep
+    };
+
+    void addRun(uint16_t start, uint16_t end);
+    void startStep();
+    void finishStep();
+    void abortTransfer();
+
+    // From the EGU interrupt, each time the TWIM stops.
+    void transferStopped();
+    friend void SWI3_EGU3_IRQHandler(void);
+
+private:
+    // The PWM registers are split across two pages on the controller.
+    static constexpr uint16_t page0RegisterCount = 180;
+
+    // The page is selected by unlocking the command register, then writing it.
+    // It locks itself again after every write.
+    static constexpr uint8_t commandRegister = 0xFD;
+    static constexpr uint8_t commandRegisterLock = 0xFE;
+    static constexpr uint8_t commandRegisterUnlock = 0xC5;
+
+    // A whole frame takes about 10 ms at 400 kHz.
+    static constexpr uint32_t transferTimeoutMs = 50;
+
+    // Unchanged registers between two runs are resent rather than
+    // starting a new transaction if there are this many or fewer of them.
+    static constexpr uint8_t coalesceGap = 4;
+
+    static constexpr uint8_t maxRunCount = 48;
+
+    // One extra byte at the front so every run has room for its register
+    // address immediately before its data, which is what the DMA sends.
+    uint8_t shadow[1 + pwmRegisterCount];
+    bool shadowValid = false;
+
+    Run runs[maxRunCount];
+    uint8_t runCount = 0;
+    uint8_t runIndex = 0;
+    int8_t currentPage = -1;
+
+    // The shadow byte the current run's register address is written over.
+    uint8_t savedByte = 0;
+
+    // The DMA can't read flash, so page selects are sent from here.
+    uint8_t command[2];
+    Step step = runStep;
+
+    NRF_TWIM_Type* twim = nullptr;
+    std::atomic<bool> transferring{false};
+    std::atomic<TaskHandle_t> waitingTask{nullptr};
+
+    OutputStage outputStage;
+    const GlassesBuffer* loadedFrame = nullptr;
+};
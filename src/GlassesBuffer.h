@@ -2,37 +2,49 @@
 
 #include <Arduino.h>
 #include "Color.h"
+#include "GlassesLayout.h"
 
+// An off-screen frame for the whole glasses (matrix and both rings), stored in
+// the same order as the IS31FL3741's PWM registers. Pixels are looked up
+// through GlassesLayout, and the finished frame can be copied straight
+// into the glasses' LED buffer with Glasses::load().
 class GlassesBuffer {
 public:
-	static constexpr uint8_t ringPixelCount = 24;
-	static constexpr uint16_t matrixWidth = 18;
-	static constexpr uint16_t matrixHeight = 5;
-	static constexpr uint16_t matrixPixelCount = matrixWidth * matrixHeight;
+	static constexpr uint8_t ringPixelCount = GlassesLayout::ringPixelCount;
+	static constexpr uint16_t matrixWidth = GlassesLayout::matrixWidth;
+	static constexpr uint16_t matrixHeight = GlassesLayout::matrixHeight;
+	static constexpr uint16_t matrixPixelCount = GlassesLayout::matrixPixelCount;
+	static constexpr uint16_t registerCount = GlassesLayout::registerCount;
+
+    GlassesBuffer() {
+        clear();
+    }
+
+    void clear() {
+        memset(registers, 0, registerCount);
+    }
 
     void fillMatrix(const Color::RGB& c) {
 		for (uint32_t i = 0; i < matrixPixelCount; i++) {
-            matrix[i] = c;
-		}        
+            setMatrixColor(i, c);
+		}
     }
 
     void fillLeftRing(const Color::RGB& c) {
         for (uint32_t i = 0; i < ringPixelCount; i++) {
-            leftRing[i] = c;
+            setLeftRingColor(i, c);
 		}
     }
 
     void fillRightRing(const Color::RGB& c) {
 		for (uint32_t i = 0; i < ringPixelCount; i++) {
-            rightRing[i] = c;
+            setRightRingColor(i, c);
 		}
     }
 
     void fillRings(const Color::RGB& c) {
-		for (uint32_t i = 0; i < ringPixelCount; i++) {
-            leftRing[i] = c;
-            rightRing[i] = c;
-		}        
+        fillLeftRing(c);
+        fillRightRing(c);
     }
 
 	void fill(const Color::RGB& c) {
@@ -42,97 +54,203 @@ public:
 
 	// Left ring pixels
 
-	Color::RGB getLeftRingColor(uint32_t index) {
-		if (index >= ringPixelCount) {
-			return Color::RGB();
-		}
-
-        return leftRing[index];
+	Color::RGB getLeftRingColor(uint32_t index) const {
+        return GlassesLayout::readPixel(registers, GlassesLayout::leftRingPixel(index));
 	}
 
 	void setLeftRingColor(uint32_t index, const Color::RGB& c) {
-		if (index >= ringPixelCount) {
-			return;
-		}
-
-        leftRing[index] = c;
+        GlassesLayout::writePixel(registers, GlassesLayout::leftRingPixel(index), c);
 	}
 
 	// Right ring pixels
 
-	Color::RGB getRightRingColor(uint32_t index) {
-		if (index >= ringPixelCount) {
-			return Color::RGB();
-		}
-
-    	return rightRing[index];
+	Color::RGB getRightRingColor(uint32_t index) const {
+        return GlassesLayout::readPixel(registers, GlassesLayout::rightRingPixel(index));
 	}
 
 	void setRightRingColor(uint32_t index, const Color::RGB& c) {
-		if (index >= ringPixelCount) {
-			return;
-		}
-
-        rightRing[index] = c;
+        GlassesLayout::writePixel(registers, GlassesLayout::rightRingPixel(index), c);
 	}
 
 	// Matrix pixels
 
-	Color::RGB getMatrixColor(uint32_t index) {
-		if (index >= matrixPixelCount) {
-			return Color::RGB();
-		}
-
-		return matrix[index];
+	Color::RGB getMatrixColor(uint32_t index) const {
+        return GlassesLayout::readPixel(registers, GlassesLayout::matrixPixel(index));
 	}
 
-	Color::RGB getMatrixColor(uint32_t x, uint32_t y) {
-        uint32_t index = (y * matrixWidth) + x;
-        return getMatrixColor(index);
-	}    
+	Color::RGB getMatrixColor(uint32_t x, uint32_t y) const {
+        if (x >= matrixWidth || y >= matrixHeight) {
+            return Color::RGB();
+        }
 
-	void setMatrixColor(uint32_t index, const Color::RGB& c) {
-		if (index >= matrixPixelCount) {
-			return;
-		}
+        return getMatrixColor((y * matrixWidth) + x);
+	}
 
-        matrix[index] = c;
+	void setMatrixColor(uint32_t index, const Color::RGB& c) {
+        GlassesLayout::writePixel(registers, GlassesLayout::matrixPixel(index), c);
 	}
 
 	void setMatrixColor(uint32_t x, uint32_t y, const Color::RGB& c) {
-        uint32_t index = (y * matrixWidth) + x;
-        setMatrixColor(index, c);
-	}    
+        if (x >= matrixWidth || y >= matrixHeight) {
+            return;
+        }
+
+        setMatrixColor((y * matrixWidth) + x, c);
+	}
 
 	// Fading
 
     void fade(uint8_t scale) {
-        fadeLeftRing(scale);
-        fadeRightRing(scale);
-        fadeMatrix(scale);
+        // Every channel is scaled the same, so the layout doesn't matter.
+	    for (uint32_t i = 0; i < registerCount; i++) {
+            registers[i] = Color::scale8(registers[i], scale);
+	    }
     }
 
 	void fadeLeftRing(uint8_t scale) {
-		fadeBuffer(leftRing, ringPixelCount, scale);
+		for (uint32_t i = 0; i < ringPixelCount; i++) {
+            fadePixel(GlassesLayout::leftRingPixel(i), scale);
+		}
 	}
 
 	void fadeRightRing(uint8_t scale) {
-		fadeBuffer(rightRing, ringPixelCount, scale);
-	}	
+		for (uint32_t i = 0; i < ringPixelCount; i++) {
+            fadePixel(GlassesLayout::rightRingPixel(i), scale);
+		}
+	}
 
 	void fadeMatrix(uint8_t scale) {
-	    fadeBuffer(matrix, matrixPixelCount, scale);
+		for (uint32_t i = 0; i < matrixPixelCount; i++) {
+            fadePixel(GlassesLayout::matrixPixel(i), scale);
+		}
 	}
 
+    // Raw PWM values in register order.
+    inline const uint8_t* getRegisters() const {
+        return registers;
+    }
+
+    inline uint8_t* getRegisters() {
+        return registers;
+    }
+
 private:
-	void fadeBuffer(Color::RGB* buffer, uint32_t numPixels, uint8_t scale) {
-	    for(uint32_t i = 0; i < numPixels; i++) { 
-            buffer[i].scale(scale);
-	    }    		
-	}
+    void fadePixel(const GlassesLayout::Pixel& p, uint8_t scale) {
+        Color::RGB c = GlassesLayout::readPixel(registers, p);
+        c.scale(scale);
+        GlassesLayout::writePixel(registers, p, c);
+    }
+
+private:
+    uint8_t registers[registerCount];
+};
+
+// Stacks several GlassesBuffers and blends them into one frame, bottom layer first.
+// Each layer has an opacity and a blend mode, and all of the math is done in
+// integer Q8 on the raw register values in a single pass, so overlays (status
+// indicators, transitions, etc.) are cheap to add on top of a scene.
+template <uint8_t LAYER_COUNT>
+class GlassesCompositor {
+public:
+    static constexpr uint8_t layerCount = LAYER_COUNT;
+
+    enum class BlendMode: uint8_t {
+        // Crossfade from what's below to this layer by its opacity.
+        alpha = 0,
+        // Add to what's below, saturating at full brightness.
+        additive,
+        // Take the brighter of this layer and what's below.
+        max
+    };
+
+public:
+    GlassesCompositor() {
+        for (uint8_t i = 0; i < layerCount; i++) {
+            setOpacity(i, 255);
+            layers[i].blendMode = BlendMode::alpha;
+            layers[i].visible = true;
+        }
+    }
+
+    inline GlassesBuffer& layer(uint8_t index) {
+        return layers[min(index, layerCount - 1)].buffer;
+    }
+
+    void setOpacity(uint8_t index, uint8_t opacity) {
+        if (index >= layerCount) {
+            return;
+        }
+
+        // Q8, so that 255 maps to 256 (fully opaque).
+        layers[index].opacity = opacity + (opacity >> 7);
+    }
+
+    void setBlendMode(uint8_t index, BlendMode mode) {
+        if (index >= layerCount) {
+            return;
+        }
+
+        layers[index].blendMode = mode;
+    }
+
+    void setVisible(uint8_t index, bool visible) {
+        if (index >= layerCount) {
+            return;
+        }
+
+        layers[index].visible = visible;
+    }
+
+    // Blend all visible layers into output.
+    void resolve(GlassesBuffer& output) const {
+        uint8_t* out = output.getRegisters();
+        const uint8_t* in[layerCount];
+        uint16_t opacity[layerCount];
+        BlendMode mode[layerCount];
+        uint8_t count = 0;
+
+        // Only walk layers that can contribute anything.
+        for (uint8_t i = 0; i < layerCount; i++) {
+            if (layers[i].visible && layers[i].opacity > 0) {
+                in[count] = layers[i].buffer.getRegisters();
+                opacity[count] = layers[i].opacity;
+                mode[count] = layers[i].blendMode;
+                count++;
+            }
+        }
+
+        for (uint16_t r = 0; r < GlassesBuffer::registerCount; r++) {
+            int16_t d = 0;
+
+            for (uint8_t i = 0; i < count; i++) {
+                int16_t s = in[i][r];
+
+                switch (mode[i]) {
+                    case BlendMode::alpha:
+                        d += ((s - d) * opacity[i]) >> 8;
+                        break;
+
+                    case BlendMode::additive:
+                        d = min(d + ((s * opacity[i]) >> 8), 255);
+                        break;
+
+                    case BlendMode::max:
+                        d = max(d, int16_t((s * opacity[i]) >> 8));
+                        break;
+                }
+            }
+
+            out[r] = d;
+        }
+    }
 
 private:
-    Color::RGB leftRing[ringPixelCount];
-    Color::RGB rightRing[ringPixelCount];
-    Color::RGB matrix[matrixPixelCount];
+    struct Layer {
+        GlassesBuffer buffer;
+        uint16_t opacity;
+        BlendMode blendMode;
+        bool visible;
+    };
+
+    Layer layers[layerCount];
 };
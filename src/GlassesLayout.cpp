@@ -0,0 +1,89 @@
+#include <Arduino.h>
+#include <Adafruit_IS31FL3741.h>
+#include "GlassesLayout.h"
+
+namespace GlassesLayout {
+
+    namespace {
+        Pixel matrixPixels[matrixPixelCount];
+        Pixel leftRingPixels[ringPixelCount];
+        Pixel rightRingPixels[ringPixelCount];
+
+        // Returned for out-of-bounds pixels, so writes through it are simply dropped.
+        const Pixel invalidPixel = {noRegister, noRegister, noRegister};
+
+        // Find the register a single-channel probe landed in.
+        uint16_t findRegister(const uint8_t* buffer) {
+            for (uint16_t i = 0; i < registerCount; i++) {
+                if (buffer[i] != 0) {
+                    return i;
+                }
+            }
+
+            return noRegister;
+        }
+
+        template <typename DrawFunction>
+        Pixel probe(uint8_t* buffer, DrawFunction draw) {
+            // Full intensity in one channel at a time, in both RGB 888 and 565.
+            static const uint32_t channels888[3] = {0xFF0000, 0x00FF00, 0x0000FF};
+            static const uint16_t channels565[3] = {0xF800, 0x07E0, 0x001F};
+            uint16_t registers[3];
+
+            for (uint8_t c = 0; c < 3; c++) {
+                memset(buffer, 0, registerCount);
+                draw(channels888[c], channels565[c]);
+                registers[c] = findRegister(buffer);
+            }
+
+            memset(buffer, 0, registerCount);
+            return {registers[0], registers[1], registers[2]};
+        }
+    }
+
+    void build(Adafruit_EyeLights_buffered& glasses) {
+        uint8_t* buffer = glasses.getBuffer();
+
+        for (uint16_t y = 0; y < matrixHeight; y++) {
+            for (uint16_t x = 0; x < matrixWidth; x++) {
+                matrixPixels[y * matrixWidth + x] = probe(buffer, [&](uint32_t, uint16_t c565) {
+                    glasses.drawPixel(x, y, c565);
+                });
+            }
+        }
+
+        for (uint8_t i = 0; i < ringPixelCount; i++) {
+            leftRingPixels[i] = probe(buffer, [&](uint32_t c888, uint16_t) {
+                glasses.left_ring.setPixelColor(i, c888);
+            });
+
+            rightRingPixels[i] = probe(buffer, [&](uint32_t c888, uint16_t) {
+                glasses.right_ring.setPixelColor(i, c888);
+            });
+        }
+    }
+
+    const Pixel& matrixPixel(uint16_t index) {
+        if (index >= matrixPixelCount) {
+            return invalidPixel;
+        }
+
+        return matrixPixels[index];
+    }
+
+    const Pixel& leftRingPixel(uint8_t index) {
+        if (index >= ringPixelCount) {
+            return invalidPixel;
+        }
+
+        return leftRingPixels[index];
+    }
+
+    const Pixel& rightRingPixel(uint8_t index) {
+        if (index >= ringPixelCount) {
+            return invalidPixel;
+        }
+
+        return rightRingPixels[index];
+    }
+}
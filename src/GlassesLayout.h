@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+#include "Color.h"
+
+class Adafruit_EyeLights_buffered;
+
+// Maps matrix and ring pixels to the IS31FL3741 PWM registers that drive them,
+// in the same order as the controller's PWM pages (and the library's LED buffer).
+namespace GlassesLayout {
+    static constexpr uint16_t registerCount = 351;
+
+    static constexpr uint8_t ringPixelCount = 24;
+    static constexpr uint16_t matrixWidth = 18;
+    static constexpr uint16_t matrixHeight = 5;
+    static constexpr uint16_t matrixPixelCount = matrixWidth * matrixHeight;
+
+    // Used for pixels that don't have an LED, e.g. the matrix's phantom corners.
+    static constexpr uint16_t noRegister = 0xFFFF;
+
+    struct Pixel {
+        uint16_t r;
+        uint16_t g;
+        uint16_t b;
+    };
+
+    // Build the tables by asking the library where it puts each pixel,
+    // so we always agree with it. Call once after the glasses are initialized.
+    void build(Adafruit_EyeLights_buffered& glasses);
+
+    const Pixel& matrixPixel(uint16_t index);
+    const Pixel& leftRingPixel(uint8_t index);
+    const Pixel& rightRingPixel(uint8_t index);
+
+    inline void writePixel(uint8_t* registers, const Pixel& p, const Color::RGB& c) {
+        if (p.r == noRegister || p.g == noRegister || p.b == noRegister) {
+            return;
+        }
+
+        registers[p.r] = c.r;
+        registers[p.g] = c.g;
+        registers[p.b] = c.b;
+    }
+
+    inline Color::RGB readPixel(const uint8_t* registers, const Pixel& p) {
+        if (p.r == noRegister || p.g == noRegister || p.b == noRegister) {
+            return Color::RGB();
+        }
+
+        return Color::RGB(registers[p.r], registers[p.g], registers[p.b]);
+    }
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <Arduino.h>
+
+// A band for GoertzelBank to listen to: its center frequency and its width, in Hz.
+struct GoertzelBand {
+    float frequency;
+    float bandwidth;
+};
+
+// Measures how loud a few frequency bands are, with one Goertzel filter per band,
+// as samples arrive. Each sample costs a multiply and two adds per band, and there's
+// no window to keep around, so a handful of bands is far cheaper than an FFT.
+//
+// A band's width sets how many samples it takes to measure: sampleRate / bandwidth.
+// Each band publishes a new amplitude at the end of each of its blocks, so narrow
+// bass bands update less often than wide treble ones.
+template<uint8_t MAX_BANDS>
+class GoertzelBank {
+public:
+    static constexpr uint32_t minBlockSize = 8;
+    static constexpr uint32_t maxBlockSize = 2048;
+
+public:
+    // Bands past MAX_BANDS, or not below half the sample rate, are left out.
+    void configure(const GoertzelBand* bands, uint8_t count, uint32_t sampleRate) {
+        bandCount = 0;
+
+        for (uint8_t i = 0; i < count && bandCount < MAX_BANDS; i++) {
+            const GoertzelBand& band = bands[i];
+
+            if (band.frequency <= 0 || band.frequency >= sampleRate / 2.0f) {
+                continue;
+            }
+
+            Filter& filter = filters[bandCount++];
+            uint32_t blockSize = uint32_t(sampleRate / max(band.bandwidth, 1.0f) + 0.5f);
+
+            filter.blockSize = constrain(blockSize, minBlockSize, maxBlockSize);
+            filter.coefficient = 2 * cosf(2 * float(M_PI) * band.frequency / sampleRate);
+
+            // A sine of amplitude A at the band's frequency ends a block with
+            // a magnitude of about A * blockSize / 2.
+            filter.scale = 2.0f / filter.blockSize;
+        }
+
+        reset();
+    }
+
+    void reset() {
+        for (uint8_t b = 0; b < bandCount; b++) {
+            Filter& filter = filters[b];
+            filter.s1 = 0;
+            filter.s2 = 0;
+            filter.remaining = filter.blockSize;
+            filter.amplitude = 0;
+        }
+    }
+
+    // Run the filters over the next count samples.
+    // Returns true if any band finished a block and has a new amplitude.
+    bool process(const int16_t* samples, uint32_t count) {
+        bool updated = false;
+
+        for (uint8_t b = 0; b < bandCount; b++) {
+            Filter& filter = filters[b];
+            float coefficient = filter.coefficient;
+            float s1 = filter.s1;
+            float s2 = filter.s2;
+            uint32_t i = 0;
+
+            while (i < count) {
+                uint32_t end = i + min(count - i, filter.remaining);
+                filter.remaining -= end - i;
+
+                for (; i < end; i++) {
+                    float s0 = samples[i] + coefficient * s1 - s2;
+                    s2 = s1;
+                    s1 = s0;
+                }
+
+                if (filter.remaining == 0) {
+                    float power = s1 * s1 + s2 * s2 - coefficient * s1 * s2;
+                    filter.amplitude = sqrtf(max(power, 0.0f)) * filter.scale;
+
+                    s1 = 0;
+                    s2 = 0;
+                    filter.remaining = filter.blockSize;
+                    updated = true;
+                }
+            }
+
+            filter.s1 = s1;
+            filter.s2 = s2;
+        }
+
+        return updated;
+    }
+
+    inline uint8_t count() const {
+        return bandCount;
+    }
+
+    // The amplitude of the band's last block, in sample units.
+    inline float amplitude(uint8_t band) const {
+        return filters[band].amplitude;
+    }
+
+    // How many samples each of the band's measurements takes.
+    inline uint32_t blockSize(uint8_t band) const {
+        return filters[band].blockSize;
+    }
+
+private:
+    struct Filter {
+        float coefficient = 0;
+        float scale = 0;
+        float s1 = 0;
+        float s2 = 0;
+        float amplitude = 0;
+        uint32_t blockSize = minBlockSize;
+        uint32_t remaining = minBlockSize;
+    };
+
+    Filter filters[MAX_BANDS];
+    uint8_t bandCount = 0;
+};
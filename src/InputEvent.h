@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+#include "Color.h"
+#include "ButtonEvent.h"
+#include "UartCommandParser.h"
+
+// Something that happened outside the render task (e.g. in a BLE callback, or
+// a command over the UART) that the scene needs to hear about. They're queued
+// (see EventQueue) and handled at the start of the next frame, in the render
+// task, so nothing else ever touches the current scene.
+struct InputEvent {
+    enum Type: uint8_t {
+        none = 0,
+        gamepadConnected,
+        gamepadDisconnected,
+        color,
+        button,
+
+        // The text itself is queued separately (see TextEvent), since it's big.
+        text
+    };
+
+    Type type = none;
+    Color::RGB rgb;
+    uint8_t buttonIndex = 0;
+    bool buttonState = false;
+
+    static InputEvent ofType(Type t) {
+        InputEvent e;
+        e.type = t;
+        return e;
+    }
+
+    static InputEvent ofColor(const Color::RGB& c) {
+        InputEvent e = ofType(color);
+        e.rgb = c;
+        return e;
+    }
+
+    static InputEvent ofButton(const ButtonEvent& b) {
+        InputEvent e = ofType(button);
+        e.buttonIndex = b.index;
+        e.buttonState = b.state;
+        return e;
+    }
+
+    inline ButtonEvent buttonEvent() const {
+        return ButtonEvent(buttonIndex, buttonState);
+    }
+};
+
+struct TextEvent {
+    UartCommand::ParamBuffer text = {};
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Smooths values that arrive once per audio block (e.g. a filterbank's bands, or
+// bar heights made from them) into values that can be read at any frame time.
+//
+// Each push() is stamped with its audio time (e.g. AudioFeatures::timeMs). The
+// values then glide from wherever they were toward the new ones over the time
+// since the previous push, so they land just as the next block is due, whatever
+// the block size or frame rate. If the next block is late they carry on along
+// the same line for a little while, then hold. That costs one block of latency.
+template<uint8_t COUNT>
+class InterpolatedBands {
+public:
+    static constexpr uint8_t count = COUNT;
+
+    // Don't glide over more than this, e.g. after the audio stopped for a while.
+    static constexpr uint32_t maxIntervalMs = 100;
+
+    // How far past the newest values to carry on, as a fraction of the interval.
+    static constexpr float maxExtrapolation = 0.5f;
+
+public:
+    // smoothingMs is the time constant of a low pass on the pushed values,
+    // in audio time, so it's the same at any block size. 0 for none.
+    InterpolatedBands(float smoothingMs = 0) : smoothingMs(smoothingMs) {
+        reset(0);
+    }
+
+    void reset(float value) {
+        for (uint8_t i = 0; i < count; i++) {
+            from[i] = value;
+            to[i] = value;
+            current[i] = value;
+        }
+
+        hasValues = false;
+        intervalMs = 0;
+        elapsedMs = 0;
+    }
+
+    void push(const float* values, uint32_t timeMs) {
+        if (!hasValues) {
+            for (uint8_t i = 0; i < count; i++) {
+                from[i] = values[i];
+                to[i] = values[i];
+                current[i] = values[i];
+            }
+
+            hasValues = true;
+            lastTimeMs = timeMs;
+            return;
+        }
+
+        uint32_t interval = min(timeMs - lastTimeMs, maxIntervalMs);
+        lastTimeMs = timeMs;
+
+        float keep = (smoothingMs > 0) ? expf(-float(interval) / smoothingMs) : 0;
+
+        // Start from what's showing now, so nothing jumps.
+        for (uint8_t i = 0; i < count; i++) {
+            from[i] = current[i];
+            to[i] = values[i] + (to[i] - values[i]) * keep;
+        }
+
+        intervalMs = interval;
+        elapsedMs = 0;
+    }
+
+    // Move along by dt milliseconds of frame time.
+    void update(uint32_t dt) {
+        if (intervalMs == 0) {
+            return;
+        }
+
+        elapsedMs = min(elapsedMs + dt, uint32_t(intervalMs * (1 + maxExtrapolation)));
+        float t = float(elapsedMs) / intervalMs;
+
+        for (uint8_t i = 0; i < count; i++) {
+            current[i] = from[i] + (to[i] - from[i]) * t;
+        }
+    }
+
+    inline float get(uint8_t i) const {
+        if (i >= count) {
+            return 0;
+        }
+
+        return current[i];
+    }
+
+private:
+    float smoothingMs;
+
+    float from[COUNT];
+    float to[COUNT];
+    float current[COUNT];
+
+    bool hasValues = false;
+    uint32_t lastTimeMs = 0;
+    uint32_t intervalMs = 0;
+    uint32_t elapsedMs = 0;
+};
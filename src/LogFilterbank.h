@@ -0,0 +1,182 @@
+#pragma once
+
+#include <Arduino.h>
+#include "ConstexprMath.h"
+#include "AudioAnalyzer.h"
+
+namespace LogFilterbankTables {
+    // Bin weights are stored in Q10.
+    static constexpr uint32_t weightOne = 1024;
+
+    // Bands narrower than this many of the short window's bins use the long window.
+    static constexpr double minShortBins = 4.0;
+
+    enum Source: uint8_t {
+        shortWindow = 0,
+        longWindow
+    };
+
+    // Where a band's center is, the centers of its neighbours (where its weights
+    // fall to zero), and which spectrum it's made from.
+    struct BandRange {
+        double lowHz = 0;
+        double centerHz = 0;
+        double highHz = 0;
+        Source source = shortWindow;
+        double binHz = 0;
+        int32_t firstBin = 0;
+        int32_t lastBin = 0;
+    };
+
+    template<uint8_t BAND_COUNT, uint16_t LOW_HZ, uint16_t HIGH_HZ>
+    constexpr BandRange bandRange(uint8_t band) {
+        const double octaves = ConstexprMath::log2(double(HIGH_HZ) / LOW_HZ);
+        const double shortBinHz = double(PdmRecorder::defaultSampleRate) / AudioFeatures::windowSize;
+        const double longBinHz = shortBinHz / AudioFeatures::longWindowDecimation;
+
+        // Centers evenly spaced in octaves, so the first band starts at
+        // LOW_HZ and the last ends at HIGH_HZ.
+        BandRange range;
+        range.lowHz = LOW_HZ * ConstexprMath::exp2(octaves * (band - 0.5) / BAND_COUNT);
+        range.centerHz = LOW_HZ * ConstexprMath::exp2(octaves * (band + 0.5) / BAND_COUNT);
+        range.highHz = LOW_HZ * ConstexprMath::exp2(octaves * (band + 1.5) / BAND_COUNT);
+
+        // The long window only covers the bottom of the spectrum, and its top
+        // bins pick up a little aliasing, so only use it well below its Nyquist.
+        double longTopHz = longBinHz * AudioFeatures::binCount / 2;
+        bool narrow = (range.highHz - range.lowHz) / 2 < shortBinHz * minShortBins;
+        range.source = (narrow && range.highHz < longTopHz) ? longWindow : shortWindow;
+        range.binHz = (range.source == longWindow) ? longBinHz : shortBinHz;
+
+        range.firstBin = int32_t(range.lowHz / range.binHz) + 1;
+        range.lastBin = int32_t(range.highHz / range.binHz);
+
+        // Always at least the bin nearest the center.
+        if (range.lastBin < range.firstBin) {
+            range.firstBin = int32_t(range.centerHz / range.binHz + 0.5);
+            range.lastBin = range.firstBin;
+        }
+
+        range.firstBin = (range.firstBin < 1) ? 1 : range.firstBin;
+        range.lastBin = (range.lastBin > AudioFeatures::binCount - 1) ? AudioFeatures::binCount - 1 : range.lastBin;
+
+        return range;
+    }
+
+    template<uint8_t BAND_COUNT, uint16_t LOW_HZ, uint16_t HIGH_HZ>
+    constexpr uint32_t weightCount() {
+        uint32_t count = 0;
+
+        for (uint8_t band = 0; band < BAND_COUNT; band++) {
+            BandRange range = bandRange<BAND_COUNT, LOW_HZ, HIGH_HZ>(band);
+            count += range.lastBin - range.firstBin + 1;
+        }
+
+        return count;
+    }
+
+    // The bins each band is made of, and how much each contributes,
+    // built at compile time and kept in flash.
+    template<uint8_t BAND_COUNT, uint16_t LOW_HZ, uint16_t HIGH_HZ>
+    struct Tables {
+        static constexpr uint32_t weightCount = LogFilterbankTables::weightCount<BAND_COUNT, LOW_HZ, HIGH_HZ>();
+
+        struct Band {
+            Source source;
+            uint16_t firstBin;
+            uint16_t binCount;
+            uint16_t firstWeight;
+        };
+
+        Band bands[BAND_COUNT];
+        uint16_t weights[weightCount];
+
+        constexpr Tables() : bands(), weights() {
+            uint16_t nextWeight = 0;
+
+            for (uint8_t band = 0; band < BAND_COUNT; band++) {
+                BandRange range = bandRange<BAND_COUNT, LOW_HZ, HIGH_HZ>(band);
+                uint16_t binCount = range.lastBin - range.firstBin + 1;
+
+                bands[band].source = range.source;
+                bands[band].firstBin = range.firstBin;
+                bands[band].binCount = binCount;
+                bands[band].firstWeight = nextWeight;
+
+                // Triangular in octaves, from 1 at the center to 0 at the neighbours' centers.
+                double binWeights[AudioFeatures::binCount] = {};
+                double totalWeight = 0.0;
+
+                for (int32_t bin = range.firstBin; bin <= range.lastBin; bin++) {
+                    double octaves = ConstexprMath::log2(bin * range.binHz / range.centerHz);
+                    double edge = ConstexprMath::log2((octaves < 0 ? range.lowHz : range.highHz) / range.centerHz);
+                    double w = 1.0 - octaves / edge;
+
+                    w = (w > 0) ? w : 0;
+                    binWeights[bin - range.firstBin] = w;
+                    totalWeight += w;
+                }
+
+                // Scale so each band's weights add up to 1, i.e. a weighted mean.
+                for (uint16_t i = 0; i < binCount; i++) {
+                    double w = (totalWeight > 0) ? binWeights[i] / totalWeight : 1.0 / binCount;
+                    weights[nextWeight++] = uint16_t(w * weightOne + 0.5);
+                }
+            }
+        }
+    };
+}
+
+// Turns the analyzer's spectra into BAND_COUNT bands evenly spaced in octaves,
+// from LOW_HZ to HIGH_HZ, as any display wants them (e.g. 18 matrix columns or
+// 24 ring pixels). Nothing is transformed here; each band is a weighted mean of
+// bins, so any number of filterbanks can share one analysis.
+//
+// Bass bands are narrower than the short window's bins, so they come from
+// AudioFeatures::longSpectrum, which is four times as long (and four times finer).
+// Turn it on with AudioAnalyzer::setLongWindowEnabled().
+template<uint8_t BAND_COUNT, uint16_t LOW_HZ, uint16_t HIGH_HZ>
+class LogFilterbank {
+public:
+    static constexpr uint8_t bandCount = BAND_COUNT;
+    static constexpr uint16_t lowHz = LOW_HZ;
+    static constexpr uint16_t highHz = HIGH_HZ;
+
+    static_assert(LOW_HZ > 0 && LOW_HZ < HIGH_HZ && HIGH_HZ < PdmRecorder::defaultSampleRate / 2, "bands must be within the spectrum");
+
+public:
+    // Compute each band's log2 magnitude in Q8, the same scale as the spectra.
+    void analyze(const AudioFeatures& features) {
+        for (uint8_t band = 0; band < bandCount; band++) {
+            const typename Tables::Band& layout = tables.bands[band];
+            const uint16_t* spectrum = (layout.source == LogFilterbankTables::longWindow) ? features.longSpectrum : features.spectrum;
+            const uint16_t* bins = &spectrum[layout.firstBin];
+            const uint16_t* weights = &tables.weights[layout.firstWeight];
+
+            uint32_t sum = 0;
+            for (uint16_t i = 0; i < layout.binCount; i++) {
+                sum += uint32_t(bins[i]) * weights[i];
+            }
+
+            bands[band] = sum / LogFilterbankTables::weightOne;
+        }
+    }
+
+    inline uint16_t getBand(uint8_t band) const {
+        if (band >= bandCount) {
+            return 0;
+        }
+
+        return bands[band];
+    }
+
+    inline const uint16_t* getBands() const {
+        return bands;
+    }
+
+private:
+    typedef LogFilterbankTables::Tables<BAND_COUNT, LOW_HZ, HIGH_HZ> Tables;
+    static constexpr Tables tables{};
+
+    uint16_t bands[BAND_COUNT] = {};
+};
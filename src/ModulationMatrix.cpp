@@ -0,0 +1,90 @@
+#include "ModulationMatrix.h"
+
+// Scenes that don't react to music themselves get a little brighter with it,
+// and livelier if they move. In a quiet room they're just as they were.
+const ModulationMatrix::Route ModulationMatrix::defaultRoutes[] = {
+    {level, brightness, linear, 0.25},
+    {level, speed, squared, 0.5},
+};
+
+const uint8_t ModulationMatrix::defaultRouteCount = sizeof(defaultRoutes) / sizeof(defaultRoutes[0]);
+
+void ModulationMatrix::setRoutes(const Route* r, uint8_t c) {
+    routes = r;
+    count = (r != nullptr) ? c : 0;
+    memset(values, 0, sizeof(values));
+}
+
+void ModulationMatrix::reset() {
+    onsetCountValid = false;
+    memset(sources, 0, sizeof(sources));
+    memset(values, 0, sizeof(values));
+}
+
+void ModulationMatrix::update(const AudioFeatures& features, uint32_t dt) {
+    updateSources(features, dt);
+
+    memset(values, 0, sizeof(values));
+
+    for (uint8_t i = 0; i < count; i++) {
+        const Route& route = routes[i];
+        float x = sources[route.source];
+
+        switch (route.curve) {
+            case linear:
+                break;
+
+            case squared:
+                x = x * x;
+                break;
+
+            case cubed:
+                x = x * x * x;
+                break;
+
+            case root:
+                x = sqrtf(x);
+                break;
+
+            case inverted:
+                x = max(1.0f - x, 0.0f);
+                break;
+        }
+
+        values[route.parameter] += x * route.gain;
+    }
+}
+
+void ModulationMatrix::updateSources(const AudioFeatures& features, uint32_t dt) {
+    sources[level] = constrain(features.level, 0.0f, 2.0f);
+
+    if (features.hasSpectrum) {
+        float floor = float(features.spectrumCeiling) - spectrumSpan;
+
+        for (uint8_t band = 0; band < AudioFeatures::bandCount; band++) {
+            float x = (features.bands[band] - floor) / spectrumSpan;
+            sources[bass + band] = constrain(x, 0.0f, 1.0f);
+        }
+
+        sources[beatPhase] = features.beatPhase;
+        sources[beatPulse] = (features.bpm > 0) ? 1.0f - features.beatPhase : 0;
+    }
+    else {
+        for (uint8_t band = 0; band < AudioFeatures::bandCount; band++) {
+            float x = (band < features.filterBandCount) ? features.filterBandLevels[band] : 0;
+            sources[bass + band] = constrain(x, 0.0f, 1.0f);
+        }
+
+        sources[beatPhase] = 0;
+        sources[beatPulse] = 0;
+    }
+
+    sources[onset] *= expf(-float(dt) / onsetDecayMs);
+
+    if (onsetCountValid && features.onsetCount != onsetCount) {
+        sources[onset] = 1;
+    }
+
+    onsetCount = features.onsetCount;
+    onsetCountValid = true;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <Arduino.h>
+#include "AudioAnalyzer.h"
+
+// Routes audio features to named scene parameters, so any scene can react to
+// music without code of its own to turn features into motion.
+//
+// A route takes one source (e.g. the level, or the bass), bends it with a curve,
+// scales it by a gain, and adds it to one parameter. Any number of routes can feed
+// the same parameter. Parameters are 0 when nothing is routed to them (or it's quiet),
+// and scenes read them as a change to their own values, e.g. with apply().
+//
+// The sources are worked out once per frame, then the routes are a walk
+// through a short table of a multiply and an add each.
+class ModulationMatrix {
+public:
+    // Everything is roughly 0 to 1, quiet to loud.
+    enum Source: uint8_t {
+        // AudioFeatures::level, which can go a little over 1 when it's louder than usual.
+        level = 0,
+
+        // From the spectrum while a scene has it on, otherwise from the first three
+        // filter bands, if any are set (see AudioAnalyzer::setFilterBands()).
+        bass,
+        mids,
+        highs,
+
+        // Only while a scene has the spectrum on. beatPhase ramps from 0 on each
+        // beat to 1 by the next, and beatPulse is the other way around.
+        beatPhase,
+        beatPulse,
+
+        // Jumps to 1 on every onset and dies away.
+        onset,
+
+        sourceCount
+    };
+
+    enum Parameter: uint8_t {
+        brightness = 0,
+        hueSpeed,
+        speed,
+        density,
+        parameterCount
+    };
+
+    enum Curve: uint8_t {
+        linear = 0,
+        squared,
+        cubed,
+        root,
+
+        // 1 - x, e.g. to dim something down in a quiet room.
+        inverted
+    };
+
+    struct Route {
+        Source source;
+        Parameter parameter;
+        Curve curve;
+        float gain;
+    };
+
+    // The routes scenes get unless they set their own.
+    static const Route defaultRoutes[];
+    static const uint8_t defaultRouteCount;
+
+public:
+    // The routes aren't copied, so keep them around (e.g. a static const table).
+    void setRoutes(const Route* routes, uint8_t count);
+
+    inline uint8_t routeCount() const {
+        return count;
+    }
+
+    // Forget the onsets seen so far, e.g. when the analyzer starts over.
+    void reset();
+
+    // Call once each frame, after the analyzer's update().
+    void update(const AudioFeatures& features, uint32_t dt);
+
+    inline float get(Parameter parameter) const {
+        return values[parameter];
+    }
+
+    inline float getSource(Source source) const {
+        return sources[source];
+    }
+
+    // Scale a scene's own value by the parameter, so 0 leaves it alone.
+    inline float apply(Parameter parameter, float value) const {
+        return value * max(1.0f + values[parameter], 0.0f);
+    }
+
+private:
+    void updateSources(const AudioFeatures& features, uint32_t dt);
+
+private:
+    // How long the onset source takes to die away to about a third.
+    static constexpr float onsetDecayMs = 100;
+
+    // The spectrum's bands are in Q8 log2; this many octaves below
+    // its ceiling counts as silent.
+    static constexpr float spectrumSpan = 4 * 256;
+
+    const Route* routes = nullptr;
+    uint8_t count = 0;
+
+    uint32_t onsetCount = 0;
+    bool onsetCountValid = false;
+
+    float sources[sourceCount] = {};
+    float values[parameterCount] = {};
+};
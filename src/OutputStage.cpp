@@ -0,0 +1,30 @@
+#include "OutputStage.h"
+#include "Color.h"
+
+void OutputStage::configure(uint8_t minB, uint8_t maxB, bool gamma) {
+    minBrightness = minB;
+    maxBrightness = maxB;
+    gammaCorrected = gamma;
+    setSceneBrightness(sceneBrightness);
+}
+
+void OutputStage::setSceneBrightness(uint8_t b) {
+    sceneBrightness = b;
+
+    uint8_t newBrightness = map(sceneBrightness, 0, 255, minBrightness, maxBrightness);
+
+    if (newBrightness == brightness && gammaCorrected == builtGammaCorrected) {
+        return;
+    }
+
+    brightness = newBrightness;
+    builtGammaCorrected = gammaCorrected;
+    rebuild();
+}
+
+void OutputStage::rebuild() {
+    for (uint16_t i = 0; i < 256; i++) {
+        uint8_t c = Color::scale8(i, brightness);
+        lut[i] = builtGammaCorrected ? Color::gamma8(c) : c;
+    }
+}
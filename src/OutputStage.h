@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Arduino.h>
+
+// The last step every frame takes on its way to the LEDs. Scenes draw linear
+// colors at full brightness, and the output stage applies the scene brightness
+// and gamma correction through a single 256 entry lookup table, which is only
+// rebuilt when the brightness actually changes.
+class OutputStage {
+public:
+    OutputStage() {
+        rebuild();
+    }
+
+    // Scenes call this on enter() to choose the range of LED brightness
+    // the scene brightness setting (0-255) maps onto.
+    void configure(uint8_t minBrightness, uint8_t maxBrightness, bool gammaCorrected = true);
+
+    // Call whenever the scene brightness setting may have changed; it's cheap if it hasn't.
+    void setSceneBrightness(uint8_t b);
+
+    // The scene brightness as last set, e.g. for scenes that draw through
+    // the canvas rather than the output stage, and apply it themselves.
+    inline uint8_t getSceneBrightness() const {
+        return sceneBrightness;
+    }
+
+    inline uint8_t apply(uint8_t x) const {
+        return lut[x];
+    }
+
+    void apply(const uint8_t* in, uint8_t* out, uint16_t count) const {
+        for (uint16_t i = 0; i < count; i++) {
+            out[i] = lut[in[i]];
+        }
+    }
+
+private:
+    void rebuild();
+
+private:
+    uint8_t lut[256];
+
+    uint8_t minBrightness = 0;
+    uint8_t maxBrightness = 255;
+    bool gammaCorrected = true;
+
+    uint8_t sceneBrightness = 255;
+
+    // What the table was last built for.
+    uint8_t brightness = 255;
+    bool builtGammaCorrected = true;
+};
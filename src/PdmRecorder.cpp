@@ -6,21 +6,60 @@
 #include <PDM.h>
 
 void PdmRecorder::reset() {
-    samplesRead = 0;
-    backBuffer = 0;
+    memset(ring, 0, sizeof(ring));
 
-    for (int b = 0; b < 2; b++) {
-        for (int i = 0; i < sampleCount; i++) {
-            audioBuffer[b][i] = 0;
-        }
-    }
+    // Start a full ring in, so the (silent) history is valid right away.
+    writePosition.store(capacity, std::memory_order_relaxed);
+    syncedPosition = capacity;
+    overruns = 0;
+    droppedSamples = 0;
+
+    leased.store(false, std::memory_order_relaxed);
+    heldBackSamples.store(0, std::memory_order_relaxed);
+
+    decimationSum = 0;
+    decimationPhase = 0;
+
+    previousInput = 0;
+    blockerOutputQ8 = 0;
+    dcEstimateQ8 = 0;
+    meanSquareQ8 = 0;
+    peakEnvelope = 0;
+
+    meanSquare.store(0, std::memory_order_relaxed);
+    peakLevel.store(0, std::memory_order_relaxed);
+    dcLevel.store(0, std::memory_order_relaxed);
 }
 
-void PdmRecorder::startRecording() {
+void PdmRecorder::startRecording(const RecordingSettings& s) {
+    // The callback mustn't be writing into the ring while it's reset.
+    if (recording) {
+        stopRecording();
+    }
+
+    settings = s;
+
+    if (settings.hardwareRate != 16000 && settings.hardwareRate != 41667) {
+        settings.hardwareRate = RecordingSettings().hardwareRate;
+    }
+
+    settings.decimation = constrain(settings.decimation, 1, maxDecimation);
+    settings.gain = min(settings.gain, uint8_t(80));
+    settings.blockSize = constrain(settings.blockSize, minBlockSize, maxRawBlockSize / settings.decimation);
+
     reset();
+
+    // The filters are set up in samples, so they depend on the rate.
+    rmsShift = windowShift(rmsWindowMs);
+    peakShift = windowShift(peakReleaseMs);
+
     recording = true;
-    busy = true;
-    PDM.begin(1, 16000);
+    sessions++;
+
+    // One callback per block.
+    PDM.setBufferSize(settings.blockSize * settings.decimation * 2);
+    PDM.setGain(settings.gain);
+    PDM.begin(1, settings.hardwareRate);
 }
 
 void PdmRecorder::stopRecording() {
@@ -33,66 +72,208 @@ void PdmRecorder::sync() {
         return;
     }
 
-    if (busy) {
-        return;
+    uint32_t p = writePosition.load(std::memory_order_acquire);
+    uint32_t recorded = p - syncedPosition;
+
+    if (recorded > capacity) {
+        overruns++;
+        droppedSamples += recorded - capacity;
+    }
+
+    syncedPosition = p;
+}
+
+const int16_t* PdmRecorder::window(uint32_t end, uint32_t count) const {
+    uint32_t p = writePosition.load(std::memory_order_acquire);
+
+    // Not recorded yet, or too long.
+    if (int32_t(p - end) < 0 || count > capacity) {
+        return nullptr;
+    }
+
+    // Overwritten.
+    if (p - end + count > capacity) {
+        return nullptr;
     }
-    
-    // Swap back/front buffers.
-    backBuffer = 1 - backBuffer;
 
-    // Start recording next batch.
-    busy = true;
+    // Thanks to the mirror, the window never wraps.
+    return &ring[(end - count) % capacity];
+}
+
+const int16_t* PdmRecorder::lease(uint32_t end, uint32_t count) const {
+    if (window(end, count) == nullptr) {
+        return nullptr;
+    }
+
+    leaseStart.store(end - count, std::memory_order_relaxed);
+    leased.store(true, std::memory_order_seq_cst);
+
+    // The callback may have overwritten them before it saw the lease.
+    const int16_t* samples = window(end, count);
+
+    if (samples == nullptr) {
+        release();
+    }
+
+    return samples;
+}
+
+void PdmRecorder::release() const {
+    leased.store(false, std::memory_order_release);
 }
 
 void PdmRecorder::readPdmData() {
     int bytesToRead = PDM.available();
+    uint32_t p = writePosition.load(std::memory_order_relaxed);
 
-    if (bytesToRead == 0) {
-        return;
+    uint8_t decimation = settings.decimation;
+
+    // Writing position q overwrites position q - capacity, which mustn't be leased.
+    bool holdBack = leased.load(std::memory_order_seq_cst);
+    uint32_t writeLimit = leaseStart.load(std::memory_order_relaxed) + capacity;
+
+    while (bytesToRead >= 2) {
+        uint32_t index = p % capacity;
+        uint32_t room = capacity - index;
+        uint32_t count;
+
+        if (holdBack) {
+            room = min(room, writeLimit - p);
+
+            if (room == 0) {
+                discardPdmData(bytesToRead);
+                break;
+            }
+        }
+
+        if (decimation == 1) {
+            // Read straight into the ring, up to its end (or the lease),
+            count = min(uint32_t(bytesToRead / 2), room);
+            count = PDM.read(&ring[index], count * 2) / 2;
+
+            if (count == 0) {
+                break;
+            }
+
+            bytesToRead -= count * 2;
+        }
+        else {
+            // or read a batch aside, and average it down into the ring, up to its end,
+            uint32_t rawCount = min(uint32_t(bytesToRead / 2), decimationBufferSize);
+            rawCount = min(rawCount, room * decimation);
+            rawCount = PDM.read(decimationBuffer, rawCount * 2) / 2;
+
+            if (rawCount == 0) {
+                break;
+            }
+
+            bytesToRead -= rawCount * 2;
+            count = decimate(decimationBuffer, rawCount, &ring[index]);
+        }
+
+        filterSamples(&ring[index], count);
+
+        // and into its mirror.
+        memcpy(&ring[index + capacity], &ring[index], count * 2);
+
+        p += count;
     }
 
-    if (busy) {
-         // Space remaining,
-        int byteLimit = (sampleCount - samplesRead) * 2;
+    // Publish the samples only after they've been written.
+    writePosition.store(p, std::memory_order_release);
 
-        // don't overflow!
-        bytesToRead = min(bytesToRead, byteLimit);
-        
-        PDM.read(&audioBuffer[backBuffer][samplesRead], bytesToRead);
+    meanSquare.store(uint32_t(meanSquareQ8 >> 8), std::memory_order_relaxed);
+    peakLevel.store(min(peakEnvelope >> 8, uint32_t(0xFFFF)), std::memory_order_relaxed);
+    dcLevel.store(dcEstimateQ8 >> 8, std::memory_order_relaxed);
+}
 
-        // Increment counter
-        samplesRead += bytesToRead / 2;
+void PdmRecorder::discardPdmData(int bytes) {
+    uint32_t discarded = 0;
 
-        // Buffer full?
-        if (samplesRead >= sampleCount) {
-            // Stop and reset counter for next time
-            busy = false;
-            samplesRead = 0;
+    // The PDM library still needs its buffer emptied.
+    while (bytes >= 2) {
+        int n = PDM.read(decimationBuffer, min(bytes, int(sizeof(decimationBuffer))));
+
+        if (n <= 0) {
+            break;
         }
+
+        bytes -= n;
+        discarded += n / 2;
     }
-    else {
-        // Mic is off (code is busy) - must read but discard data. audioBuf[2] is a 'bit bucket' for this.
-        PDM.read(audioBuffer[2], bytesToRead);        
+
+    heldBackSamples.fetch_add(discarded / settings.decimation, std::memory_order_relaxed);
+}
+
+uint32_t PdmRecorder::decimate(const int16_t* in, uint32_t count, int16_t* out) {
+    uint8_t decimation = settings.decimation;
+    uint32_t written = 0;
+
+    // A partial run carries over to the next callback.
+    for (uint32_t i = 0; i < count; i++) {
+        decimationSum += in[i];
+
+        if (++decimationPhase == decimation) {
+            out[written++] = decimationSum / decimation;
+            decimationSum = 0;
+            decimationPhase = 0;
+        }
     }
+
+    return written;
 }
 
-float PdmRecorder::magnitude() const {
-    const int16_t* buffer = frontBuffer();
-    float mean = 0;
+void PdmRecorder::filterSamples(int16_t* samples, uint32_t count) {
+    uint8_t msShift = rmsShift;
+    uint8_t pkShift = peakShift;
+
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t x = samples[i];
+
+        // One pole DC blocker: y[n] = x[n] - x[n - 1] + (1 - 2^-k) * y[n - 1]
+        blockerOutputQ8 += ((x - previousInput) << 8) - (blockerOutputQ8 >> dcBlockerShift);
+        previousInput = x;
 
-    for (int i = 0; i < sampleCount; i++) {
-        mean += buffer[i];
+        int32_t y = constrain(blockerOutputQ8 >> 8, -32768, 32767);
+        samples[i] = y;
+
+        // What the blocker is taking out, for anyone curious.
+        dcEstimateQ8 += ((x << 8) - dcEstimateQ8) >> dcEstimateShift;
+
+        // Exponential moving average of y^2.
+        int64_t squareQ8 = int64_t(y * y) << 8;
+        meanSquareQ8 += (squareQ8 - meanSquareQ8) >> msShift;
+
+        // Peak: jump up instantly, then decay.
+        uint32_t levelQ8 = uint32_t(abs(y)) << 8;
+
+        if (levelQ8 > peakEnvelope) {
+            peakEnvelope = levelQ8;
+        }
+        else {
+            peakEnvelope -= peakEnvelope >> pkShift;
+        }
     }
-    mean /= sampleCount;
-    
-    int32_t minBuf = int(mean);
-    float samplesSum = 0;
-
-    for (int i = 0; i < sampleCount; i++) {
-        int16_t sample = buffer[i];
-        samplesSum += float(sample - minBuf) * (sample - minBuf);
+}
+
+uint8_t PdmRecorder::windowShift(uint16_t ms) const {
+    uint32_t samples = uint32_t(ms) * sampleRate() / 1000;
+    uint8_t shift = 1;
+
+    // Nearest power of two.
+    while (shift < 20 && (1UL << shift) + (1UL << (shift - 1)) <= samples) {
+        shift++;
     }
 
-    // Serial.printf("mean: %f, mag: %f\n", mean, magnitude);    
-    return sqrt(samplesSum / sampleCount);
-}
\ No newline at end of file
+    return shift;
+}
+
+void PdmRecorder::setRmsWindow(uint16_t ms) {
+    rmsWindowMs = ms;
+    rmsShift = windowShift(ms);
+}
+
+void PdmRecorder::setPeakRelease(uint16_t ms) {
+    peakReleaseMs = ms;
+    peakShift = windowShift(ms);
+}
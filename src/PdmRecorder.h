@@ -5,47 +5,205 @@
 #pragma once
 
 #include <Arduino.h>
+#include <atomic>
 
+// What a scene needs from the mic, passed to PdmRecorder::startRecording() in its enter().
+// Scenes that only want loudness can ask for less, and save interrupt time and power.
+struct RecordingSettings {
+    // The PDM hardware only runs at 16000 or 41667 Hz. Lower rates come from
+    // averaging every decimation samples in the PDM callback.
+    uint32_t hardwareRate = 16000;
+    uint8_t decimation = 1;
+
+    // In half dB steps, from 0 (-20 dB) to 80 (+20 dB).
+    uint8_t gain = 20;
+
+    // Samples (after decimation) per PDM callback, and per AudioAnalyzer block.
+    // At most PdmRecorder::maxRawBlockSize / decimation.
+    uint16_t blockSize = 128;
+
+    inline uint32_t sampleRate() const {
+        return hardwareRate / decimation;
+    }
+};
+
+// Records the mic into a lock-free single-producer/single-consumer ring buffer.
+// The PDM callback is the only writer and never waits on the main loop, so no
+// samples are dropped when a frame runs long. The ring is mirrored (every sample
+// is stored twice, capacity apart), so any window of recent samples can be
+// handed out as one contiguous pointer without copying.
+//
+// As samples arrive they also go through a DC blocking filter (so the ring
+// holds DC free audio), and the running RMS and peak levels are updated,
+// so reading the current loudness never has to loop over a window.
 class PdmRecorder {
 public:
+    // The spectrum (and everything built on it) assumes this rate.
+    static constexpr uint32_t defaultSampleRate = 16000;
+
+    static constexpr uint8_t maxDecimation = 8;
+    static constexpr uint16_t minBlockSize = 16;
+
+    // The PDM library hands over samples from a double buffer with fixed 512 byte
+    // halves (DEFAULT_PDM_BUFFER_SIZE), so a block can't be more than 256 samples
+    // before decimation, i.e. maxRawBlockSize / decimation after.
+    static constexpr uint16_t maxRawBlockSize = 256;
+
+    // The analysis window most consumers use.
     static constexpr int32_t sampleCount = 512;
 
+    // How much history is kept. A window stays valid until this many
+    // minus its length newer samples have been recorded.
+    static constexpr uint32_t capacity = 4096;
+
 public:
     PdmRecorder() = default;
     ~PdmRecorder() = default;
 
-    void startRecording();
+    // Settings that are out of range are clamped, or replaced with the defaults.
+    void startRecording(const RecordingSettings& s = RecordingSettings());
     void stopRecording();
 
-    inline bool isRecording() { 
+    inline const RecordingSettings& getSettings() const {
+        return settings;
+    }
+
+    inline uint32_t sampleRate() const {
+        return settings.sampleRate();
+    }
+
+    inline uint16_t blockSize() const {
+        return settings.blockSize;
+    }
+
+    inline bool isRecording() const { 
         return recording;
     }
 
+    // Counts up every startRecording(), so consumers can tell the recording
+    // was restarted (and positions started over) even if they never saw it stop.
+    inline uint32_t session() const {
+        return sessions;
+    }
+
     // This needs to be called PDM data ready callback in the main file.
     void readPdmData();
 
-    // Call this once each loop.
+    // Call this once each frame. Takes a snapshot of how much has been recorded,
+    // so everything reading the recorder during the frame sees the same samples.
     void sync();
 
-    // This is the "draw" buffer, i.e. the buffer
-    // that's not currently being written to by the mic.
+    // Total samples recorded as of the last sync(). Wraps around, so compare
+    // positions by subtraction.
+    inline uint32_t position() const {
+        return syncedPosition;
+    }
+
+    // The count samples ending at position end, or nullptr if they
+    // haven't been recorded yet or have since been overwritten.
+    const int16_t* window(uint32_t end, uint32_t count) const;
+
+    // Lends the count samples ending at position end to the caller, to read in
+    // place (e.g. straight into an FFT) for as long as it needs. Until release(),
+    // the PDM callback won't overwrite them: if it runs out of room, it drops the
+    // newest samples instead, and counts them in droppedSampleCount(). Returns
+    // nullptr, without leasing anything, if window() would. One lease at a time.
+    const int16_t* lease(uint32_t end, uint32_t count) const;
+    void release() const;
+
+    // The latest count samples as of the last sync().
+    inline const int16_t* latest(uint32_t count) const {
+        return window(syncedPosition, count);
+    }
+
+    // The latest sampleCount samples, i.e. the "draw" buffer.
     inline const int16_t* frontBuffer() const {
-        return audioBuffer[1 - backBuffer];
+        return latest(sampleCount);
+    }
+
+    // Times the consumer fell so far behind that samples were overwritten
+    // before a sync() saw them, and how many samples that was in total.
+    inline uint32_t overrunCount() const {
+        return overruns;
+    }
+
+    inline uint32_t droppedSampleCount() const {
+        return droppedSamples + heldBackSamples.load(std::memory_order_relaxed);
+    }
+
+    // Loudness over roughly the last setRmsWindow() milliseconds, in sample units.
+    inline float rms() const {
+        return sqrtf(meanSquare.load(std::memory_order_relaxed));
+    }
+
+    // The largest recent sample, decaying over roughly setPeakRelease() milliseconds.
+    inline uint16_t peak() const {
+        return peakLevel.load(std::memory_order_relaxed);
     }
 
-    // Calculate magnitude of the data in frontBuffer().
-    float magnitude() const;
+    // The mic's DC offset, which is being filtered out of the samples.
+    inline int16_t dc() const {
+        return dcLevel.load(std::memory_order_relaxed);
+    }
+
+    // Both are rounded to the nearest power of two samples at the current rate.
+    void setRmsWindow(uint16_t ms);
+    void setPeakRelease(uint16_t ms);
 
 private:
     void reset();
 
+    // Both run in the PDM callback, on the samples just read.
+    uint32_t decimate(const int16_t* in, uint32_t count, int16_t* out);
+    void discardPdmData(int bytes);
+    void filterSamples(int16_t* samples, uint32_t count);
+
+    uint8_t windowShift(uint16_t ms) const;
+
 private:
-    // Front (draw) buffer, back (write) buffer, and garbage buffer for everything else.
-    int16_t audioBuffer[3][sampleCount];
-    uint8_t backBuffer = 0;
+    int16_t ring[capacity * 2];
+
+    // Only ever written by readPdmData().
+    std::atomic<uint32_t> writePosition{0};
 
-    volatile bool busy = false;
-    volatile int samplesRead = 0;
+    uint32_t syncedPosition = 0;
+    uint32_t overruns = 0;
+    uint32_t droppedSamples = 0;
+
+    // The oldest leased sample, if there's a lease. Leasing doesn't change what's
+    // been recorded, so it works through a const recorder. Samples the callback
+    // couldn't write because of a lease are counted separately, since it's the writer.
+    mutable std::atomic<bool> leased{false};
+    mutable std::atomic<uint32_t> leaseStart{0};
+    std::atomic<uint32_t> heldBackSamples{0};
 
     bool recording = false;
-};
\ No newline at end of file
+    uint32_t sessions = 0;
+    RecordingSettings settings;
+
+    // Raw samples wait here to be decimated.
+    static constexpr uint32_t decimationBufferSize = 256;
+    int16_t decimationBuffer[decimationBufferSize];
+    int32_t decimationSum = 0;
+    uint8_t decimationPhase = 0;
+
+    // Filter state, only touched by filterSamples(). Q8 for precision.
+    // The DC blocker's pole is 1 - 2^-7, which puts its corner around 20 Hz.
+    static constexpr uint8_t dcBlockerShift = 7;
+    static constexpr uint8_t dcEstimateShift = 10;
+    int32_t previousInput = 0;
+    int32_t blockerOutputQ8 = 0;
+    int32_t dcEstimateQ8 = 0;
+    int64_t meanSquareQ8 = 0;
+    uint32_t peakEnvelope = 0;
+
+    uint16_t rmsWindowMs = 32;
+    uint16_t peakReleaseMs = 128;
+    volatile uint8_t rmsShift = 9;
+    volatile uint8_t peakShift = 11;
+
+    // Published for the main loop after each batch of samples.
+    std::atomic<uint32_t> meanSquare{0};
+    std::atomic<uint16_t> peakLevel{0};
+    std::atomic<int16_t> dcLevel{0};
+};
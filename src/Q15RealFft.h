@@ -0,0 +1,158 @@
+#pragma once
+
+#include <Arduino.h>
+#include "FastLog2.h"
+#include "ConstexprMath.h"
+
+namespace Q15RealFftTables {
+    using ConstexprMath::pi;
+
+    constexpr int16_t toQ15(double x) {
+        double scaled = x * 32768.0 + (x >= 0 ? 0.5 : -0.5);
+        return (scaled >= 32767.0) ? 32767 : (scaled <= -32768.0) ? -32768 : int16_t(scaled);
+    }
+
+    // Everything the transform needs for SAMPLE_COUNT, built at compile time and kept in flash.
+    template<uint32_t SAMPLE_COUNT>
+    struct Tables {
+        static constexpr uint32_t halfCount = SAMPLE_COUNT / 2;
+
+        // cos and sin of 2 * pi * k / SAMPLE_COUNT, for k < SAMPLE_COUNT / 2.
+        int16_t cosine[halfCount];
+        int16_t sine[halfCount];
+
+        // Periodic Hann window.
+        int16_t window[SAMPLE_COUNT];
+
+        // Bit reversed indices for the half size complex transform.
+        uint16_t bitReverse[halfCount];
+
+        constexpr Tables() : cosine(), sine(), window(), bitReverse() {
+            for (uint32_t k = 0; k < halfCount; k++) {
+                double theta = 2.0 * pi * k / SAMPLE_COUNT;
+                cosine[k] = toQ15(ConstexprMath::cosine(theta));
+                sine[k] = toQ15(ConstexprMath::sine(theta));
+            }
+
+            for (uint32_t n = 0; n < SAMPLE_COUNT; n++) {
+                window[n] = toQ15(0.5 - 0.5 * ConstexprMath::cosine(2.0 * pi * n / SAMPLE_COUNT));
+            }
+
+            uint32_t bits = 0;
+            while ((1UL << bits) < halfCount) {
+                bits++;
+            }
+
+            for (uint32_t i = 0; i < halfCount; i++) {
+                uint32_t r = 0;
+
+                for (uint32_t b = 0; b < bits; b++) {
+                    r |= ((i >> b) & 1) << (bits - 1 - b);
+                }
+
+                bitReverse[i] = r;
+            }
+        }
+    };
+}
+
+// A Hann windowed real-input FFT in Q15 fixed point. The real samples are packed
+// into a complex transform of half the size, which is then split back out into
+// the real spectrum, so it does about half the work of a complex FFT of the
+// same length. Each stage scales by 1/2, so nothing can overflow.
+template<uint32_t SAMPLE_COUNT>
+class Q15RealFft {
+public:
+    static constexpr uint32_t sampleCount = SAMPLE_COUNT;
+    static constexpr uint32_t binCount = SAMPLE_COUNT / 2;
+
+    static_assert(SAMPLE_COUNT >= 4 && (SAMPLE_COUNT & (SAMPLE_COUNT - 1)) == 0, "SAMPLE_COUNT must be a power of two");
+
+    // log2 of the magnitude of bins lowBin to highBin (inclusive) in Q8, written to out[lowBin..highBin].
+    void log2Magnitudes(const int16_t* samples, uint16_t lowBin, uint16_t highBin, uint16_t* out) {
+        transform(samples);
+
+        highBin = min(highBin, uint16_t(binCount - 1));
+
+        for (uint16_t k = lowBin; k <= highBin; k++) {
+            // Halve the log of the squared magnitude, rather than taking a square root.
+            out[k] = fastLog2Q8(binMagnitudeSquared(k)) >> 1;
+        }
+    }
+
+    // Squared magnitude of bin k, after transform().
+    uint64_t binMagnitudeSquared(uint16_t k) const {
+        const Tables& t = tables;
+
+        // Pull the spectra of the even and odd samples back
+        // apart from Z[k] and conj(Z[M - k]).
+        uint16_t mk = (k == 0) ? 0 : halfCount - k;
+        int32_t ar = re[k];
+        int32_t ai = im[k];
+        int32_t br = re[mk];
+        int32_t bi = -im[mk];
+
+        int32_t evenRe = (ar + br) >> 1;
+        int32_t evenIm = (ai + bi) >> 1;
+        int32_t oddRe = (ai - bi) >> 1;
+        int32_t oddIm = (br - ar) >> 1;
+
+        // X[k] = even + W^k * odd
+        int32_t c = t.cosine[k];
+        int32_t s = t.sine[k];
+        int32_t xr = evenRe + ((c * oddRe + s * oddIm) >> 15);
+        int32_t xi = evenIm + ((c * oddIm - s * oddRe) >> 15);
+
+        return uint64_t(int64_t(xr) * xr) + uint64_t(int64_t(xi) * xi);
+    }
+
+    // Window and transform samples. The spectrum is left in place for binMagnitudeSquared().
+    void transform(const int16_t* samples) {
+        const Tables& t = tables;
+
+        // Window, pack even/odd samples into real/imaginary, and bit reverse in one go.
+        // An extra halving leaves headroom for the complex magnitude in the first stage.
+        for (uint32_t m = 0; m < halfCount; m++) {
+            uint16_t r = t.bitReverse[m];
+            re[r] = (int32_t(samples[2 * m]) * t.window[2 * m]) >> 16;
+            im[r] = (int32_t(samples[2 * m + 1]) * t.window[2 * m + 1]) >> 16;
+        }
+
+        for (uint32_t size = 2; size <= halfCount; size <<= 1) {
+            uint32_t half = size >> 1;
+
+            // Twiddles for this stage are every step'th entry of the full size table.
+            uint32_t step = sampleCount / size;
+
+            for (uint32_t start = 0; start < halfCount; start += size) {
+                for (uint32_t k = 0; k < half; k++) {
+                    int32_t wr = t.cosine[k * step];
+                    int32_t wi = -t.sine[k * step];
+
+                    uint32_t i = start + k;
+                    uint32_t j = i + half;
+
+                    int32_t tr = (re[j] * wr - im[j] * wi) >> 15;
+                    int32_t ti = (re[j] * wi + im[j] * wr) >> 15;
+
+                    int32_t ur = re[i];
+                    int32_t ui = im[i];
+
+                    re[i] = (ur + tr) >> 1;
+                    im[i] = (ui + ti) >> 1;
+                    re[j] = (ur - tr) >> 1;
+                    im[j] = (ui - ti) >> 1;
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t halfCount = SAMPLE_COUNT / 2;
+
+    typedef Q15RealFftTables::Tables<SAMPLE_COUNT> Tables;
+    static constexpr Tables tables{};
+
+    int16_t re[halfCount];
+    int16_t im[halfCount];
+};
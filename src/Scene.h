@@ -17,6 +17,23 @@ public:
     virtual void enter() {}
     virtual void exit() {}
     virtual void update(uint32_t dt) {}
+    virtual void fixedUpdate(uint32_t dt) {}
+    virtual void draw() {}
+
+    // Frame pacing (see FrameScheduler).
+    // How many times per second the scene wants to be updated and drawn.
+    virtual uint16_t frameRate() const { return 60; }
+
+    // If non-zero, fixedUpdate() is called with exactly this dt (in milliseconds)
+    // as many times as needed to keep up, after update() and before draw().
+    // Handy for physics-like motion that should step the same regardless of frame timing.
+    virtual uint16_t fixedTimestep() const { return 0; }
+
+    // Render-on-change. Call invalidate() whenever something that affects the
+    // scene's pixels changes; frames where nothing did skip draw() and show().
+    // Scenes start out invalidated, so they're always drawn at least once.
+    inline void invalidate() { renderNeeded = true; }
+    inline bool needsRender() const { return renderNeeded; }
 
     // External events
     virtual void gamepadConnected() {}
@@ -37,5 +54,8 @@ protected:
     }
 
 private:
+    friend class FrameScheduler;
+
     Device& device;
+    bool renderNeeded = true;
 };
\ No newline at end of file
@@ -15,6 +15,8 @@ void Settings::begin(Adafruit_EEPROM_I2C* eep, bool eraseEeprom) {
         return;
     }
 
+    acquireBus();
+
     if (eraseEeprom) {
         LOGLN("Erasing eeprom header...");
 
@@ -336,6 +338,8 @@ bool Settings::write(uint16_t addr, uint8_t value, const char* successMessage) {
         return false;
     }    
 
+    acquireBus();
+
     if (eeprom->write(addr, value)) {
         LOGLN(successMessage);
         return true;
@@ -349,6 +353,8 @@ bool Settings::writeBuffer(uint16_t addr, uint8_t* buffer, uint16_t count, const
         return false;
     }
 
+    acquireBus();
+
     if (eeprom->write(addr, buffer, count)) {
         LOGLN(successMessage);
         return true;
@@ -363,6 +369,7 @@ bool Settings::writeObject(uint16_t addr, const T& object, const char* successMe
         return 0;
     }
 
+    acquireBus();
     uint16_t wrote = eeprom->writeObject(addr, object);
 
     if (wrote == sizeof(object)) {
@@ -371,3 +378,10 @@ bool Settings::writeObject(uint16_t addr, const T& object, const char* successMe
 
     return wrote;
 }
+
+
+void Settings::acquireBus() {
+    if (busAcquireCallback != nullptr) {
+        busAcquireCallback();
+    }
+}
\ No newline at end of file
@@ -74,6 +74,12 @@ public:
     void begin(Adafruit_EEPROM_I2C* _eeprom = nullptr, bool eraseEeprom = false);
     bool hasEeprom();
 
+    // Called before every EEPROM access, so the owner of a
+    // shared I2C bus can make sure it's free first.
+    void setBusAcquireCallback(void (*cb)()) {
+        busAcquireCallback = cb;
+    }
+
     uint8_t sceneIndex() const;
     void setSceneIndex(uint8_t i);
 
@@ -157,7 +163,10 @@ private:
     template <class T> 
     bool writeObject(uint16_t addr, const T &value, const char* successMessage);
 
+    void acquireBus();
+
 private:
     MemoryMap memoryMap;
     Adafruit_EEPROM_I2C* eeprom = nullptr;
+    void (*busAcquireCallback)() = nullptr;
 };
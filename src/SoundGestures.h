@@ -0,0 +1,284 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Listens for claps and whistles, so the glasses can be driven hands free.
+// It runs on every sample all the time, even in scenes that don't use audio,
+// so it's kept to a few adds and compares per sample, with no spectrum at all:
+//
+// A clap is a sudden peak, many times louder than the room, that has died away
+// again a moment later. Two in a row, not too close together, is a double clap.
+//
+// A whistle is close to a pure tone, so its zero crossings come at very even
+// intervals, which noise, speech and most music don't manage for long.
+class SoundGestures {
+public:
+    // Claps are looked for in frames this long.
+    static constexpr uint32_t frameMs = 2;
+
+    static constexpr float minWhistleHz = 500;
+    static constexpr float maxWhistleHz = 3500;
+
+public:
+    SoundGestures() {
+        configure(16000);
+    }
+
+    void configure(uint32_t rate) {
+        sampleRate = rate;
+        frameSize = max(sampleRate * frameMs / 1000, uint32_t(1));
+        maxHz = min(maxWhistleHz, sampleRate * 0.45f);
+        reset();
+    }
+
+    // Forget what's been heard, e.g. when the recording restarts. The counts keep counting.
+    void reset() {
+        framePeak = 0;
+        frameSum = 0;
+        frameSamples = 0;
+        background = minBackground;
+
+        clapState = listening;
+        clapTimer = 0;
+        clapMean = 0;
+        sinceLastClap = doubleClapMaxMs;
+
+        previous = 0;
+        armed = false;
+        sinceCrossing = 0;
+        crossingFraction = 0;
+        lastInterval = 0;
+        intervalCount = 0;
+        intervalSum = 0;
+        jitterSum = 0;
+        whistleSamples = 0;
+        tonalFrames = 0;
+        quietFrames = 0;
+        whistling = false;
+        whistleHz = 0;
+    }
+
+    void process(const int16_t* samples, uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            int32_t x = samples[i];
+
+            // Clap frames.
+            uint32_t level = abs(x);
+            framePeak = max(framePeak, level);
+            frameSum += level;
+
+            if (++frameSamples == frameSize) {
+                endClapFrame();
+            }
+
+            // Whistle zero crossings, only counted after the signal has been
+            // well below zero, so the noise around zero doesn't add any.
+            sinceCrossing++;
+
+            if (x < -whistleThreshold) {
+                armed = true;
+            }
+            else if (armed && x >= 0 && previous < 0) {
+                // Where between the samples it crossed.
+                float fraction = float(-previous) / (x - previous);
+                float interval = sinceCrossing + fraction - crossingFraction;
+
+                addInterval(interval);
+
+                sinceCrossing = 0;
+                crossingFraction = fraction;
+                armed = false;
+            }
+
+            previous = x;
+
+            if (++whistleSamples == frameSize * whistleFrames) {
+                endWhistleFrame();
+            }
+        }
+    }
+
+    // Count up, so anything polling at any rate can tell whether it missed one.
+    inline uint32_t clapCount() const {
+        return claps;
+    }
+
+    inline uint32_t doubleClapCount() const {
+        return doubleClaps;
+    }
+
+    inline bool isWhistling() const {
+        return whistling;
+    }
+
+    // 0 unless whistling.
+    inline float whistleFrequency() const {
+        return whistling ? whistleHz : 0;
+    }
+
+private:
+    void endClapFrame() {
+        uint32_t mean = frameSum / frameSize;
+        uint32_t peak = framePeak;
+
+        framePeak = 0;
+        frameSum = 0;
+        frameSamples = 0;
+
+        sinceLastClap = min(sinceLastClap + frameMs, doubleClapMaxMs);
+
+        switch (clapState) {
+            case listening:
+                if (peak > minClapPeak && peak > background * clapRatio) {
+                    clapState = decaying;
+                    clapTimer = 0;
+                    clapMean = mean;
+                }
+                else {
+                    // The room, which a clap doesn't count toward.
+                    background += (float(mean) - background) * backgroundSmoothing;
+                    background = max(background, minBackground);
+                }
+                break;
+
+            case decaying:
+                clapMean = max(clapMean, mean);
+                clapTimer += frameMs;
+
+                if (clapTimer >= clapDecayMs) {
+                    // A clap is over by now; anything still loud is something else.
+                    if (mean * 4 < clapMean) {
+                        clap();
+                    }
+                    else {
+                        // Still loud, so the room got louder (e.g. music started).
+                        background = max(background, float(mean));
+                    }
+
+                    clapState = refractory;
+                    clapTimer = 0;
+                }
+                break;
+
+            case refractory:
+                background += (float(mean) - background) * backgroundSmoothing;
+                background = max(background, minBackground);
+                clapTimer += frameMs;
+
+                if (clapTimer >= clapRefractoryMs) {
+                    clapState = listening;
+                }
+                break;
+        }
+    }
+
+    void clap() {
+        claps++;
+
+        // sinceLastClap was measured from the end of the last clap's decay.
+        if (sinceLastClap >= doubleClapMinMs && sinceLastClap < doubleClapMaxMs) {
+            doubleClaps++;
+            sinceLastClap = doubleClapMaxMs;
+        }
+        else {
+            sinceLastClap = 0;
+        }
+    }
+
+    void addInterval(float interval) {
+        if (lastInterval > 0) {
+            jitterSum += fabsf(interval - lastInterval);
+            intervalSum += interval;
+            intervalCount++;
+        }
+
+        lastInterval = interval;
+    }
+
+    void endWhistleFrame() {
+        bool tonal = false;
+
+        if (intervalCount >= minCrossings) {
+            float mean = intervalSum / intervalCount;
+            float hz = sampleRate / mean;
+
+            tonal = hz >= minWhistleHz && hz <= maxHz && jitterSum < maxJitter * mean * intervalCount;
+
+            if (tonal) {
+                whistleHz = hz;
+            }
+        }
+
+        whistleSamples = 0;
+        intervalSum = 0;
+        jitterSum = 0;
+        intervalCount = 0;
+
+        // Whistles start and stop slowly compared to everything else, so it
+        // takes a while to start one, and a few frames without to stop it.
+        if (tonal) {
+            quietFrames = 0;
+            tonalFrames = min(tonalFrames + 1, whistleStartFrames);
+            whistling = whistling || tonalFrames >= whistleStartFrames;
+        }
+        else if (++quietFrames >= whistleStopFrames) {
+            tonalFrames = 0;
+            whistling = false;
+        }
+    }
+
+private:
+    // Claps.
+    static constexpr uint32_t minClapPeak = 4000;
+    static constexpr float clapRatio = 8;
+    static constexpr float minBackground = 50;
+    static constexpr float backgroundSmoothing = float(frameMs) / 250;
+    static constexpr uint32_t clapDecayMs = 60;
+    static constexpr uint32_t clapRefractoryMs = 60;
+    static constexpr uint32_t doubleClapMinMs = 50;
+    static constexpr uint32_t doubleClapMaxMs = 500;
+
+    // Whistles, in frames of whistleFrames clap frames (16 ms).
+    static constexpr int32_t whistleThreshold = 300;
+    static constexpr uint32_t whistleFrames = 8;
+    static constexpr uint32_t minCrossings = 6;
+    static constexpr float maxJitter = 0.06f;
+    static constexpr uint32_t whistleStartFrames = 15;
+    static constexpr uint32_t whistleStopFrames = 4;
+
+    enum ClapState: uint8_t {
+        listening,
+        decaying,
+        refractory
+    };
+
+    uint32_t sampleRate = 0;
+    uint32_t frameSize = 1;
+    float maxHz = maxWhistleHz;
+
+    uint32_t framePeak = 0;
+    uint32_t frameSum = 0;
+    uint32_t frameSamples = 0;
+    float background = minBackground;
+
+    ClapState clapState = listening;
+    uint32_t clapTimer = 0;
+    uint32_t clapMean = 0;
+    uint32_t sinceLastClap = doubleClapMaxMs;
+    uint32_t claps = 0;
+    uint32_t doubleClaps = 0;
+
+    int32_t previous = 0;
+    bool armed = false;
+    uint32_t sinceCrossing = 0;
+    float crossingFraction = 0;
+    float lastInterval = 0;
+    uint32_t intervalCount = 0;
+    float intervalSum = 0;
+    float jitterSum = 0;
+    uint32_t whistleSamples = 0;
+    uint32_t tonalFrames = 0;
+    uint32_t quietFrames = 0;
+    bool whistling = false;
+    float whistleHz = 0;
+};
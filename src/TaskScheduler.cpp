@@ -0,0 +1,122 @@
+#include "TaskScheduler.h"
+#include "CycleCounter.h"
+
+uint8_t TaskScheduler::addTask(const char* name, Callback callback, uint32_t periodMs, uint8_t priority) {
+    if (count >= maxTasks || callback == nullptr) {
+        return invalidTask;
+    }
+
+    uint8_t id = count++;
+    Task& task = tasks[id];
+    task.name = name;
+    task.callback = callback;
+    task.period = max(periodMs, uint32_t(1));
+    task.priority = priority;
+
+    uint32_t now = millis();
+    task.nextRunTime = now;
+    task.lastRunTime = now;
+
+    // Insert after everything of the same or higher priority, so ties run in the order they were added.
+    uint8_t position = id;
+
+    while (position > 0 && tasks[order[position - 1]].priority < priority) {
+        order[position] = order[position - 1];
+        position--;
+    }
+
+    order[position] = id;
+    return id;
+}
+
+void TaskScheduler::setPeriod(uint8_t id, uint32_t periodMs, uint32_t now) {
+    if (id >= count) {
+        return;
+    }
+
+    Task& task = tasks[id];
+    task.period = max(periodMs, uint32_t(1));
+    task.nextRunTime = now;
+}
+
+void TaskScheduler::reset(uint32_t now) {
+    for (uint8_t i = 0; i < count; i++) {
+        tasks[i].nextRunTime = now;
+        tasks[i].lastRunTime = now;
+    }
+}
+
+uint8_t TaskScheduler::run(uint32_t now) {
+    uint8_t ran = 0;
+
+    for (uint8_t i = 0; i < count; i++) {
+        Task& task = tasks[order[i]];
+
+        if (!isDue(task, now)) {
+            continue;
+        }
+
+        uint32_t dt = now - task.lastRunTime;
+        task.lastRunTime = now;
+
+        task.nextRunTime += task.period;
+
+        // If it fell more than a period behind, don't try to make it up.
+        if (isDue(task, now)) {
+            task.nextRunTime = now + task.period;
+            task.stats.lateRuns++;
+        }
+
+        uint32_t start = CycleCounter::now();
+        task.callback(dt);
+        uint32_t cycles = CycleCounter::since(start);
+
+        task.stats.runs++;
+        task.stats.totalCycles += cycles;
+        task.stats.maxCycles = max(task.stats.maxCycles, cycles);
+
+        ran++;
+    }
+
+    return ran;
+}
+
+uint32_t TaskScheduler::timeUntilNextTask(uint32_t now) const {
+    uint32_t wait = UINT32_MAX;
+
+    for (uint8_t i = 0; i < count; i++) {
+        const Task& task = tasks[i];
+
+        if (isDue(task, now)) {
+            return 0;
+        }
+
+        wait = min(wait, task.nextRunTime - now);
+    }
+
+    return (count > 0) ? wait : 0;
+}
+
+void TaskScheduler::resetStats() {
+    for (uint8_t i = 0; i < count; i++) {
+        tasks[i].stats = Stats();
+    }
+}
+
+void TaskScheduler::printStats(Print& out) const {
+    const uint32_t cyclesPerMicro = F_CPU / 1000000;
+
+    for (uint8_t i = 0; i < count; i++) {
+        const Task& task = tasks[order[i]];
+        const Stats& stats = task.stats;
+        uint32_t mean = (stats.runs > 0) ? stats.totalCycles / stats.runs : 0;
+
+        out.printf("%-10s %4lu ms: %6lu runs, %4lu late, %6lu us mean, %6lu us max\n",
+            task.name,
+            (unsigned long)task.period,
+            (unsigned long)stats.runs,
+            (unsigned long)stats.lateRuns,
+            (unsigned long)(mean / cyclesPerMicro),
+            (unsigned long)(stats.maxCycles / cyclesPerMicro));
+    }
+}
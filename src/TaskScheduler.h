@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Runs the main loop's subsystems cooperatively, each at its own rate, so that
+// low rate chores (e.g. the status LEDs) don't run on every pass of the loop.
+//
+// Each task has a period and a priority. On each pass, every task that's due
+// runs once, highest priority first. Tasks with the same period that were
+// (re)scheduled at the same time stay in step, so they always run in the same
+// pass, in priority order (e.g. input, then audio, then the scene).
+//
+// Every run is timed in CPU cycles (see CycleCounter), so it's easy to see
+// which task is eating the frame budget.
+class TaskScheduler {
+public:
+    typedef void (*Callback)(uint32_t dt);
+
+    static constexpr uint8_t maxTasks = 12;
+    static constexpr uint8_t invalidTask = 0xFF;
+
+    struct Stats {
+        uint32_t runs = 0;
+        uint32_t lateRuns = 0;
+        uint64_t totalCycles = 0;
+        uint32_t maxCycles = 0;
+    };
+
+public:
+    // Returns the task's id, or invalidTask if there's no room for it.
+    // The callback gets the milliseconds since the task last ran.
+    uint8_t addTask(const char* name, Callback callback, uint32_t periodMs, uint8_t priority);
+
+    // Change how often a task runs. It runs next at now, and every periodMs after.
+    void setPeriod(uint8_t task, uint32_t periodMs, uint32_t now);
+
+    // Start timing over, e.g. after something blocked for a long time,
+    // so tasks don't see a huge dt.
+    void reset(uint32_t now);
+
+    // Run every task that's due. Returns how many did.
+    uint8_t run(uint32_t now);
+
+    // How long the caller can sleep before the next task is due.
+    uint32_t timeUntilNextTask(uint32_t now) const;
+
+    inline uint8_t taskCount() const {
+        return count;
+    }
+
+    inline const char* name(uint8_t task) const {
+        return tasks[task].name;
+    }
+
+    inline uint32_t period(uint8_t task) const {
+        return tasks[task].period;
+    }
+
+    inline const Stats& stats(uint8_t task) const {
+        return tasks[task].stats;
+    }
+
+    void resetStats();
+
+    // One line per task: runs, late runs, and the mean and worst run times in microseconds.
+    void printStats(Print& out) const;
+
+private:
+    struct Task {
+        const char* name = nullptr;
+        Callback callback = nullptr;
+        uint32_t period = 0;
+        uint8_t priority = 0;
+        uint32_t nextRunTime = 0;
+        uint32_t lastRunTime = 0;
+        Stats stats;
+    };
+
+    static inline bool isDue(const Task& task, uint32_t now) {
+        return int32_t(now - task.nextRunTime) >= 0;
+    }
+
+private:
+    Task tasks[maxTasks];
+
+    // Task ids, highest priority first.
+    uint8_t order[maxTasks];
+    uint8_t count = 0;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Adafruit_ZeroFFT.h>
+#include "FastLog2.h"
+
+// The original ColumnSpectrumizer FFT, behind the same interface as Q15RealFft.
+template<uint32_t SAMPLE_COUNT>
+class ZeroFftBackend {
+public:
+    static constexpr uint32_t sampleCount = SAMPLE_COUNT;
+
+    // log2 of the magnitude of bins lowBin to highBin (inclusive) in Q8, written to out[lowBin..highBin].
+    void log2Magnitudes(const int16_t* samples, uint16_t lowBin, uint16_t highBin, uint16_t* out) {
+        memcpy(buffer, samples, sizeof(buffer));
+
+        // Leaves the magnitudes in the first half of the buffer.
+        ZeroFFT(buffer, sampleCount);
+
+        for (uint16_t i = lowBin; i <= highBin; i++) {
+            out[i] = (buffer[i] > 0) ? fastLog2Q8(buffer[i]) : 0;
+        }
+    }
+
+private:
+    int16_t buffer[sampleCount];
+};
@@ -13,10 +13,12 @@
 #include <PDM.h>
 #include <Adafruit_EEPROM_I2C.h>
 #include "Config.h"
+#include "Glasses.h"
 #include "BLEClientHidGamepad.h"
 #include "Gamepad.h"
 #include "SoftGamepad.h"
 #include "PdmRecorder.h"
+#include "ModulationMatrix.h"
 #include "Device.h"
 #include "DigitalInput.h"
 #include "ShakeDetector.h"
@@ -24,6 +26,11 @@
 #include "Settings.h"
 
 #include "Scene.h"
+#include "FrameScheduler.h"
+#include "TaskScheduler.h"
+#include "EventQueue.h"
+#include "InputEvent.h"
+#include "CycleCounter.h"
 #include "scenes/ShiftyEyes/ShiftyEyesScene.h"
 #include "scenes/Beam/BeamScene.h"
 #include "scenes/GooglyRings/GooglyRingsScene.h"
@@ -80,17 +87,21 @@ Scene* currentScene = nullptr;
 // Device
 ////////////////////////////
 Adafruit_LIS3DH accel;
-Adafruit_EyeLights_buffered glasses(true);
+Glasses glasses(true);
 Adafruit_EEPROM_I2C eeprom;
 Gamepad gamepad;
 SoftGamepad softGamepad;
 PdmRecorder pdmRecorder;
+AudioAnalyzer audioAnalyzer(pdmRecorder);
+ModulationMatrix modulation;
 Settings settings;
 
 Device device(
     accel, 
     glasses, 
     pdmRecorder,
+    audioAnalyzer,
+    modulation,
     gamepad, 
     softGamepad,
     settings
@@ -99,6 +110,24 @@ Device device(
 // Used for detecting shakes from the nunchuck to change scenes.
 ShakeDetector gamepadShake(3);
 
+// Hands free: a double clap taps the right button (next scene),
+// and whistling holds down button 1 for as long as it lasts.
+const uint8_t doubleClapButtonIndex = 7;
+const uint8_t whistleButtonIndex = 0;
+uint32_t heardDoubleClaps = 0;
+bool heardWhistle = false;
+bool releaseDoubleClapButton = false;
+
+// While the current scene doesn't record anything itself, the mic listens in the
+// background, for the gestures above and for the modulation matrix's default routes.
+bool backgroundListening = false;
+
+const GoertzelBand backgroundBands[] = {
+    {150, 100},     // bass
+    {800, 400},     // mids
+    {2500, 1000},   // highs
+};
+
 // Used for pairing and changing scenes.
 DigitalPinInput modeButton(4);
 const uint32_t pairingHoldDuration = 3000;
@@ -111,9 +140,14 @@ bool ignoreModeButtonFell = false;
 BLEUart bleUart;
 BLEDis  bleUartDis;
 BLEClientHidGamepad hidGamepad;
-bool isPairing = false;
+// Shared between the BLE callbacks and the render task.
+std::atomic<bool> isPairing{false};
 const uint16_t invalidConnectionHandle = BLE_MAX_CONNECTION;
-uint16_t gamepadConnectionHandle = invalidConnectionHandle;
+std::atomic<uint16_t> gamepadConnectionHandle{invalidConnectionHandle};
+
+// Set by the render task when the mode button has been held long enough to pair.
+// Clearing the bonds takes a second or two, so the loop task does it.
+std::atomic<bool> pairingRequested{false};
 
 UartCommand::Parser uartCommandParser;
 uint32_t bleUartLastRxTime = 0;
@@ -127,7 +161,50 @@ const uint16_t ledConnectedColor = Color::RGB(0, 0, 2).packed();
 ////////////////////////////
 // Timing
 ////////////////////////////
-uint32_t millisLast = 0;
+FrameScheduler frameScheduler;
+
+// Everything that touches the scene, the glasses or the status LEDs runs in
+// the render task, at a higher priority than loop(), so frames are on time
+// whatever the BLE UART is up to. The loop task reads the UART, and does
+// anything slow in the BLE stack (e.g. clearing bonds) for the render task.
+TaskScheduler renderScheduler;
+TaskScheduler loopScheduler;
+
+const UBaseType_t renderTaskPriority = TASK_PRIO_NORMAL;
+const uint32_t renderTaskStackWords = 256 * 6;
+TaskHandle_t renderTaskHandle = nullptr;
+
+// Higher priorities run first when several tasks are due at once. The frame
+// tasks all run at the scene's frame rate, in this order, so input is sampled
+// once per frame and the scene sees every button edge exactly once.
+const uint8_t inputPriority = 30;
+const uint8_t bleUartPriority = 25;
+const uint8_t audioPriority = 20;
+const uint8_t scenePriority = 10;
+const uint8_t chorePriority = 0;
+
+// Anything that happens in another task (BLE callbacks, UART commands) is
+// queued here for the render task, which handles it at the start of the next frame.
+EventQueue<InputEvent, 32> inputEvents;
+EventQueue<TextEvent, 2> textEvents;
+
+// Set when a text was queued but its event wasn't, because the event queue was
+// full. Each text event pops the oldest text, so nothing else is queued until
+// the missing event is, or every text after would be one behind.
+bool textEventPending = false;
+
+uint8_t inputTask = TaskScheduler::invalidTask;
+uint8_t audioTask = TaskScheduler::invalidTask;
+uint8_t sceneTask = TaskScheduler::invalidTask;
+
+// The scene brightness the glasses last showed.
+uint8_t shownSceneBrightness = 0;
+
+// The modulation matrix only ever brightens the scene from its setting, and it's
+// smoothed and stepped, so the brightness doesn't change on every audio block.
+const float brightnessSmoothingMs = 150;
+const uint8_t brightnessStep = 8;
+float brightnessBoost = 0;
 
 ////////////////////////////
 // Forward declarations
@@ -141,12 +218,24 @@ void setScene(Scene* scene);
 void nextScene();
 void previousScene();
 
+void initTasks();
+void renderTask(void* parameters);
+void handleInputEvents();
+void updateInput(uint32_t dt);
+void updateAudio(uint32_t dt);
+void updateScene(uint32_t dt);
+uint8_t modulatedSceneBrightness(uint32_t dt);
+void logTaskStats(uint32_t dt);
+
 void updateModeSelection(uint32_t dt);
 void updateNunchuck();
+void updateSoundGestures();
 void readPdmData();
-void updateConnectionLeds();
-void updateBleUart();
-void updateBleUartTimeout();
+void updateConnectionLeds(uint32_t dt);
+void updateBleUart(uint32_t dt);
+void updateBleUartTimeout(uint32_t dt);
+void updatePairingRequest(uint32_t dt);
+void waitForGlassesTransfer();
 
 void uartFlush();
 
@@ -154,6 +243,7 @@ void uartFlush();
 void uartCommandColor(const Color::RGB& c);
 void uartCommandButtonEvent(const ButtonEvent& e);
 void uartCommandText(const char* text);
+bool queuePendingTextEvent();
 void uartCommandError(const char* msg);
 
 void scanCallback(ble_gap_evt_adv_report_t* report);
@@ -177,6 +267,7 @@ void setup() {
     analogWrite(bleUartPairedLedPin, 0);    
 
     Serial.begin(115200);
+    CycleCounter::begin();
     // while(!Serial) { delay(10); }
   
     // Both I2C devices can use 400kHz, but the accel driver sets
@@ -202,41 +293,45 @@ void setup() {
     initSettings(eepromInitialized);
 
     // Everything else
+    audioAnalyzer.setSoundGesturesEnabled(true);
     initBle();
+    initTasks();
     initScene();
 
-    // Reset timer
-    millisLast = millis();
+    // Reset timers
+    uint32_t now = millis();
+    renderScheduler.reset(now);
+    loopScheduler.reset(now);
+    frameScheduler.reset(now);
+
+    // From here on, only the render task touches the scene.
+    xTaskCreate(renderTask, "render", renderTaskStackWords, nullptr, renderTaskPriority, &renderTaskHandle);
 }
 
 ////////////////////////////
 // Loop
 ////////////////////////////
 void loop() {
-    uint32_t now = millis();
-    uint32_t dt = now - millisLast;
-    millisLast = now;
+    loopScheduler.run(millis());
 
-    // Let at least 1 ms elapse.
-    if (dt == 0) {
-        delay(1);
-        return;
-    }
+    uint32_t wait = loopScheduler.timeUntilNextTask(millis());
 
-    // Serial.printf("dt: %d\n", dt);
+    if (wait > 0) {
+        vTaskDelay(ms2tick(wait));
+    }
+}
 
-    updateBleUart();
-    updateBleUartTimeout();
-    updateConnectionLeds();
-    softGamepad.update();
-    updateNunchuck();
-    pdmRecorder.sync();
+void renderTask(void* parameters) {
+    for (;;) {
+        renderScheduler.run(millis());
 
-    if (currentScene != nullptr) {
-        currentScene->update(dt);
+        // The last frame keeps going out to the glasses while we sleep; only
+        // show(), or anything else that wants the I2C bus, waits for it.
+        // Always sleep at least a tick, even when running behind,
+        // so the lower priority loop task still gets to read the UART.
+        uint32_t wait = renderScheduler.timeUntilNextTask(millis());
+        vTaskDelay(max(ms2tick(wait), TickType_t(1)));
     }
-
-    updateModeSelection(dt);
 }
 
 ////////////////////////////
@@ -296,6 +391,7 @@ void initSettings(bool eepromInitialized) {
     }    
 
     // Initialize the settings based on the information we've gathered
+    settings.setBusAcquireCallback(waitForGlassesTransfer);
     settings.begin(eepromInitialized ? &eeprom : nullptr, eraseEeprom);
 
     if (eraseEeprom) {
@@ -390,11 +486,15 @@ void initBle() {
     }
 }
 
+void waitForGlassesTransfer() {
+    glasses.waitForTransfer();
+}
+
 void readPdmData() {
     pdmRecorder.readPdmData();
 }
 
-void updateConnectionLeds() {
+void updateConnectionLeds(uint32_t dt) {
     // Show the red LED if we're connected to a UART peripheral.
     if (Bluefruit.Periph.connected()) {
         analogWrite(bleUartPairedLedPin, 8);
@@ -403,7 +503,7 @@ void updateConnectionLeds() {
         analogWrite(bleUartPairedLedPin, 0);
     }
 
-    if (isPairing) {
+    if (isPairing || pairingRequested) {
         pixel.fill(ledPairingColor);        
     } 
     else if (Bluefruit.Central.connected()) {
@@ -416,6 +516,129 @@ void updateConnectionLeds() {
     pixel.show();
 }
 
+void initTasks() {
+    // Render task, once per frame (see setScene()).
+    inputTask = renderScheduler.addTask("input", updateInput, frameScheduler.frameInterval(), inputPriority);
+    audioTask = renderScheduler.addTask("audio", updateAudio, frameScheduler.frameInterval(), audioPriority);
+    sceneTask = renderScheduler.addTask("scene", updateScene, frameScheduler.frameInterval(), scenePriority);
+
+    // Render task chores nobody would notice running any faster.
+    renderScheduler.addTask("leds", updateConnectionLeds, 100, chorePriority);
+
+    #if defined(LOGGER)
+    renderScheduler.addTask("stats", logTaskStats, 5000, chorePriority);
+    #endif
+
+    // Loop task. Commands are only a few bytes, but shouldn't wait a whole frame.
+    loopScheduler.addTask("ble uart", updateBleUart, 10, bleUartPriority);
+    loopScheduler.addTask("uart idle", updateBleUartTimeout, 100, chorePriority);
+    loopScheduler.addTask("pairing", updatePairingRequest, 100, chorePriority);
+}
+
+void handleInputEvents() {
+    InputEvent event;
+
+    while (inputEvents.pop(event)) {
+        switch (event.type) {
+            case InputEvent::gamepadConnected:
+                device.setGamepadConnected(true);
+                gamepadShake.reset();
+
+                if (currentScene != nullptr) {
+                    currentScene->gamepadConnected();
+                    currentScene->invalidate();
+                }
+                break;
+
+            case InputEvent::gamepadDisconnected:
+                device.setGamepadConnected(false);
+
+                if (currentScene != nullptr) {
+                    currentScene->gamepadDisconnected();
+                    currentScene->invalidate();
+                }
+                break;
+
+            case InputEvent::color:
+                if (currentScene != nullptr) {
+                    currentScene->receivedColor(event.rgb);
+                    currentScene->invalidate();
+                }
+                break;
+
+            case InputEvent::button:
+                softGamepad.event(event.buttonEvent());
+                break;
+
+            case InputEvent::text: {
+                TextEvent text;
+
+                if (textEvents.pop(text) && currentScene != nullptr) {
+                    currentScene->receivedText(text.text);
+                    currentScene->invalidate();
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+}
+
+void updateInput(uint32_t dt) {
+    // Before the soft gamepad, so a button event shows up this frame.
+    handleInputEvents();
+    softGamepad.update();
+    updateNunchuck();
+}
+
+void updateAudio(uint32_t dt) {
+    pdmRecorder.sync();
+    audioAnalyzer.update();
+    updateSoundGestures();
+    modulation.update(audioAnalyzer.features(), dt);
+}
+
+void updateScene(uint32_t dt) {
+    // Brightness is applied to each frame on output, and only costs anything when it changes.
+    uint8_t sceneBrightness = modulatedSceneBrightness(dt);
+    bool brightnessChanged = sceneBrightness != shownSceneBrightness;
+    shownSceneBrightness = sceneBrightness;
+    glasses.output().setSceneBrightness(sceneBrightness);
+
+    // Scenes that draw through the canvas apply the brightness themselves, so they have to draw again.
+    if (brightnessChanged && !glasses.hasLoadedFrame() && currentScene != nullptr) {
+        currentScene->invalidate();
+    }
+
+    bool drawn = frameScheduler.run(millis());
+
+    // Scenes that load frames through the output stage don't; their last frame is just loaded again.
+    if (brightnessChanged && !drawn && glasses.reload()) {
+        glasses.show();
+    }
+
+    updateModeSelection(dt);
+}
+
+uint8_t modulatedSceneBrightness(uint32_t dt) {
+    uint8_t setting = settings.sceneBrightness();
+    float boost = max(modulation.apply(ModulationMatrix::brightness, setting) - setting, 0.0f);
+    brightnessBoost += (boost - brightnessBoost) * (1.0f - expf(-float(dt) / brightnessSmoothingMs));
+
+    uint32_t steps = uint32_t(brightnessBoost / brightnessStep + 0.5f);
+    return min(setting + steps * brightnessStep, uint32_t(255));
+}
+
+void logTaskStats(uint32_t dt) {
+    #if defined(LOGGER)
+    renderScheduler.printStats(LOGGER);
+    renderScheduler.resetStats();
+    LOGFMT("%lu input events, %lu texts dropped\n", (unsigned long)inputEvents.droppedCount(), (unsigned long)textEvents.droppedCount());
+    #endif
+}
+
 void initScene() {
     sceneIndex = settings.sceneIndex();;
     Scene* s = sceneFactories[sceneIndex]->createScene(device);
@@ -425,14 +648,52 @@ void initScene() {
 void setScene(Scene* scene) {
     if (currentScene != nullptr) {
         currentScene->exit();
+        glasses.forgetLoadedFrame();
         delete currentScene;
     }
 
     currentScene = scene;
 
+    // The next scene may want the mic for itself, with its own settings.
+    if (backgroundListening) {
+        audioAnalyzer.setFilterBands(nullptr, 0);
+        pdmRecorder.stopRecording();
+        backgroundListening = false;
+    }
+
+    // Scenes set their own routes in enter(), if they want any.
+    modulation.setRoutes(nullptr, 0);
+    modulation.reset();
+
     if (currentScene != nullptr) {
         currentScene->enter();
     }
+
+    // Scenes that don't use audio leave the mic to listen for claps and whistles,
+    // at 8 kHz (plenty for whistling) to keep the interrupts down, and react
+    // to music through the default routes, with a few filter bands for sources.
+    if (!pdmRecorder.isRecording()) {
+        RecordingSettings listening;
+        listening.decimation = 2;
+        listening.blockSize = 64;
+        pdmRecorder.startRecording(listening);
+        backgroundListening = true;
+
+        audioAnalyzer.setFilterBands(backgroundBands, sizeof(backgroundBands) / sizeof(backgroundBands[0]));
+
+        if (modulation.routeCount() == 0) {
+            modulation.setRoutes(ModulationMatrix::defaultRoutes, ModulationMatrix::defaultRouteCount);
+        }
+    }
+
+    uint32_t now = millis();
+    frameScheduler.setScene(currentScene, now);
+
+    // Keep the frame tasks in step at the new frame rate.
+    uint32_t frameInterval = frameScheduler.frameInterval();
+    renderScheduler.setPeriod(inputTask, frameInterval, now);
+    renderScheduler.setPeriod(audioTask, frameInterval, now);
+    renderScheduler.setPeriod(sceneTask, frameInterval, now);
 }
 
 void nextScene() {
@@ -495,31 +756,13 @@ void updateModeSelection(uint32_t dt) {
 
         // Trigger pairing
         if (wasHeld && isFinishedHolding) {
-            // Disconnect from currently connected gamepad, if connected.
-            BLEConnection* conn = Bluefruit.Connection(gamepadConnectionHandle);
-
-            if (conn != nullptr) {
-                LOGLN("Disconnecting from gamepad...");
-                conn->disconnect();
-            }
-
             // Ignore the next button release, so we don't trigger a scene change.
             ignoreModeButtonFell = true;                        
 
-            // Clearing the bonds can take a second or two, so:
-            // 1) Turn the pairing LED on now
+            // Turn the pairing LED on now, and leave the BLE stack to the loop task.
             pixel.fill(ledPairingColor);
             pixel.show();            
-
-            // 2) Clear the bonds
-            Bluefruit.Central.clearBonds();
-
-            // 3) Reset the scene timer to prevent a huge dt on the next loop.
-            millisLast = millis();
-
-            // We are now pairing.
-            isPairing = true;
-            LOGLN("Entering pairing mode...");
+            pairingRequested = true;
         }
     }
     else if (softGamepad.wasPressed(softGamepad.buttonRight) || gamepadShake.shakeDetected()) {
@@ -536,6 +779,29 @@ void updateModeSelection(uint32_t dt) {
     }
 }
 
+void updateSoundGestures() {
+    const AudioFeatures& features = audioAnalyzer.features();
+
+    // Release a double clap's tap the frame after pressing it, so both edges are seen.
+    if (releaseDoubleClapButton) {
+        softGamepad.event(ButtonEvent(doubleClapButtonIndex, false));
+        releaseDoubleClapButton = false;
+    }
+
+    if (features.doubleClapCount != heardDoubleClaps) {
+        heardDoubleClaps = features.doubleClapCount;
+        LOGLN("Heard a double clap");
+        softGamepad.event(ButtonEvent(doubleClapButtonIndex, true));
+        releaseDoubleClapButton = true;
+    }
+
+    if (features.whistling != heardWhistle) {
+        heardWhistle = features.whistling;
+        LOGFMT("Whistle %s (%.0f Hz)\n", heardWhistle ? "started" : "stopped", features.whistleHz);
+        softGamepad.event(ButtonEvent(whistleButtonIndex, heardWhistle));
+    }
+}
+
 void updateNunchuck() {
     if (!hidGamepad.discovered()) {
         return;
@@ -617,18 +883,13 @@ void centralConnectionSecuredCallback(uint16_t connHandle) {
 
         if (hidGamepad.gamepadPresent()) {
             hidGamepad.enableGamepad();
-            device.setGamepadConnected(true);
-            gamepadShake.reset();
-
-            if (currentScene != nullptr) {
-                currentScene->gamepadConnected();
-            }
+            inputEvents.push(InputEvent::ofType(InputEvent::gamepadConnected));
         }
     }
 }
 
 bool centralPairPasskeyCallback(uint16_t connHandle, uint8_t const passkey[6], bool matchRequest) {
-    LOGFMT("pairPasskeyCallback, isPairing: %d\n", isPairing);
+    LOGFMT("pairPasskeyCallback, isPairing: %d\n", isPairing.load());
     return isPairing;
 }
 
@@ -698,12 +959,7 @@ void centralDisconnectCallback(uint16_t connHandle, uint8_t reason) {
 
     if (gamepadConnectionHandle == connHandle) {
         gamepadConnectionHandle = invalidConnectionHandle;
-
-        device.setGamepadConnected(false);
-
-        if (currentScene != nullptr) {
-            currentScene->gamepadDisconnected();
-        }        
+        inputEvents.push(InputEvent::ofType(InputEvent::gamepadDisconnected));
     }
 
     hidGamepad.disableGamepad();
@@ -717,7 +973,9 @@ void peripheralDisconnectCallback(uint16_t conn_hdl, uint8_t reason) {
     LOGFMT("Disconnected from UART client, reason: 0x%X\n", reason);
 }
 
-void updateBleUart() {
+void updateBleUart(uint32_t dt) {
+    queuePendingTextEvent();
+
     if (!Bluefruit.Periph.connected()) {
         return;
     }
@@ -738,7 +996,31 @@ void updateBleUart() {
     }
 }
 
-void updateBleUartTimeout() {
+void updatePairingRequest(uint32_t dt) {
+    if (!pairingRequested) {
+        return;
+    }
+
+    // Disconnect from currently connected gamepad, if connected.
+    BLEConnection* conn = Bluefruit.Connection(gamepadConnectionHandle);
+
+    if (conn != nullptr) {
+        LOGLN("Disconnecting from gamepad...");
+        conn->disconnect();
+    }
+
+    Bluefruit.Central.clearBonds();
+
+    // Reset the timers to prevent a huge dt on the next pass.
+    loopScheduler.reset(millis());
+
+    // We are now pairing.
+    isPairing = true;
+    pairingRequested = false;
+    LOGLN("Entering pairing mode...");
+}
+
+void updateBleUartTimeout(uint32_t dt) {
     if (uartCommandParser.isIdle()) {
         return;
     }
@@ -763,23 +1045,40 @@ void uartFlush() {
 
 void uartCommandColor(const Color::RGB& c) {
     LOGFMT("Received color: r: %d, g: %d, b: %d\n", c.r, c.g, c.b);
-
-    if (currentScene != nullptr) {
-        currentScene->receivedColor(c);
-    }
+    inputEvents.push(InputEvent::ofColor(c));
 }
 
 void uartCommandButtonEvent(const ButtonEvent& e) {
     LOGFMT("Received button event: index: %d, state: %d\n", e.index, e.state);
-    softGamepad.event(e);
+    inputEvents.push(InputEvent::ofButton(e));
 }
 
 void uartCommandText(const char* text) {
     LOGFMT("Received text: %s\n", text);
 
-    if (currentScene) {
-        currentScene->receivedText(text);
+    if (!queuePendingTextEvent()) {
+        textEvents.countDropped();
+        return;
     }
+
+    // The text goes first, so it's there when the event is handled.
+    TextEvent event;
+    strlcpy(event.text, text, sizeof(event.text));
+
+    if (textEvents.push(event)) {
+        textEventPending = true;
+        queuePendingTextEvent();
+    }
+}
+
+// Only called from the loop task, the only one that queues text.
+// Returns false if there's still a text event waiting for room.
+bool queuePendingTextEvent() {
+    if (textEventPending && inputEvents.push(InputEvent::ofType(InputEvent::text))) {
+        textEventPending = false;
+    }
+
+    return !textEventPending;
 }
 
 void uartCommandError(const char* msg) {
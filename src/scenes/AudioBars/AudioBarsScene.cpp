@@ -1,16 +1,39 @@
 #include "AudioBarsScene.h"
 #include "Color.h"
 
+#if defined(AUDIO_BARS_FFT_BENCHMARK)
+#define LOGGER Serial
+#endif
+#include "Logger.h"
+
 AudioBarsScene::AudioBarsScene(Device& d) :
-    Scene(d),
-    spectrumizer(10, 70)
+    Scene(d)
 {
+    // Column colors never change, and brightness is applied on output.
+    for (int i = 0; i < columnCount; i++) {
+        columnColors[i] = Color::HSV(57600UL * i / columnCount, 255, 255).toRGB();
+    }
 
+    for (int i = 0; i < ringPixelCount; i++) {
+        ringColors[i] = Color::HSV(57600UL * i / ringPixelCount, 255, 255).toRGB();
+    }
 }
 
 void AudioBarsScene::enter() {
-    spectrumizer.reset();
-    getDevice().pdmRecorder.startRecording();
+    // The bars have never been gamma corrected, and look better that way.
+    getDevice().glasses.output().configure(32, 255, false);
+
+    bars.reset();
+    ringLevels.reset(0);
+    memset(ringBrightness, 0, sizeof(ringBrightness));
+
+    // The spectrum needs the default rate. The bars only move once a frame,
+    // so 16 ms blocks (half the default's callbacks) lose nothing.
+    RecordingSettings recording;
+    recording.blockSize = 256;
+    getDevice().pdmRecorder.startRecording(recording);
+    getDevice().audioAnalyzer.setSpectrumEnabled(true);
+    getDevice().audioAnalyzer.setLongWindowEnabled(true);
 
     Settings& settings = getDevice().settings;
     useCustomColor = settings.audioBarsUseCustomColor();
@@ -22,7 +45,7 @@ void AudioBarsScene::enter() {
 void AudioBarsScene::update(uint32_t dt) {
     Gamepad& gamepad = getDevice().gamepad;
     SoftGamepad& softGamepad = getDevice().softGamepad;
-    PdmRecorder& pdmRecorder = getDevice().pdmRecorder;
+    AudioAnalyzer& audioAnalyzer = getDevice().audioAnalyzer;
     Settings& settings = getDevice().settings;
 
     if (gamepad.isDown(gamepad.buttonC)) {
@@ -33,6 +56,8 @@ void AudioBarsScene::update(uint32_t dt) {
         if (hue >= 65535.0) {
             hue = 0.0;
         }
+
+        invalidate();
     }
     else if (gamepad.wasReleased(gamepad.buttonC)) {
         settings.audioBarsSetUseCustomColor(useCustomColor);
@@ -42,64 +67,129 @@ void AudioBarsScene::update(uint32_t dt) {
     else if (gamepad.wasPressed(gamepad.buttonZ)) {
         useCustomColor = false;
         settings.audioBarsSetUseCustomColor(useCustomColor);
+        invalidate();
     }
 
     if (softGamepad.wasPressed(softGamepad.button1)) {
         snowCapped = !snowCapped;
         settings.audioBarsSetSnowCapped(snowCapped);
+        invalidate();
+    }
+
+    // New spectrum every audio block, and the dots fall every frame.
+    const AudioFeatures& features = audioAnalyzer.features();
+
+    if (features.version != featuresVersion && features.hasSpectrum) {
+        featuresVersion = features.version;
+        columnBands.analyze(features);
+        bars.analyze(columnBands.getBands(), features.spectrumCeiling, features.timeMs);
+
+        ringBands.analyze(features);
+        analyzeRings(features);
+    }
+
+    // Both move smoothly between audio blocks, at whatever the frame rate is.
+    bars.update(dt);
+    ringLevels.update(dt);
+
+    #if defined(AUDIO_BARS_FFT_BENCHMARK)
+    // Once a second, time both FFT backends on the same samples.
+    benchmarkElapsed += dt;
+
+    const int16_t* samples = getDevice().pdmRecorder.frontBuffer();
+
+    if (benchmarkElapsed >= 1000 && samples != nullptr) {
+        benchmarkElapsed = 0;
+        auto result = fftBenchmark.run(samples, 1, AudioFeatures::binCount - 1);
+        LOGFMT("ZeroFFT: %lu cycles, Q15RealFft: %lu cycles, max difference: %.02f, analysis: %lu cycles\n",
+            result.zeroFftCycles, result.q15Cycles, result.maxLog2Difference, audioAnalyzer.lastAnalysisCycles());
+    }
+    #endif
+
+    for (int i = 0; i < columnCount; i++) {
+        ColumnPixels pixels;
+        pixels.top = max(int16_t(bars.getColumnTop(i)), 0);
+        pixels.dot = min(bars.getColumnDot(i), 4);
+
+        if (pixels.top != columnPixels[i].top || pixels.dot != columnPixels[i].dot) {
+            columnPixels[i] = pixels;
+            invalidate();
+        }
+    }
+
+    for (int i = 0; i < ringPixelCount; i++) {
+        // Squared so quiet bands stay dark.
+        float level = ringLevels.get(i);
+        uint8_t brightness = constrain(level * level, 0.0f, 1.0f) * 255;
+
+        if (brightness != ringBrightness[i]) {
+            ringBrightness[i] = brightness;
+            invalidate();
+        }
     }
+}
 
-    spectrumizer.update(pdmRecorder.frontBuffer(), dt);
-    draw();
+void AudioBarsScene::fixedUpdate(uint32_t dt) {
+    bars.fall();
 }
 
 void AudioBarsScene::draw() {
     Glasses& glasses = getDevice().glasses;
-    Settings& settings = getDevice().settings;
-
-    glasses.fill(0);
 
-    uint8_t brightness = map(settings.sceneBrightness(), 0, 255, 32, 255);
-    // Serial.printf("%d, %d\n", settings.sceneBrightness(), brightness);
+    frame.clear();
 
-    uint16_t rgbOverride = Color::HSV(uint16_t(hue), saturation, brightness).toRGB().packed565();
+    Color::RGB rgbOverride = Color::HSV(uint16_t(hue), saturation, 255).toRGB();
 
     // Reduce brightness of pure white, because it's a lot brighter than other colors.
-    uint16_t defaultDotColor = Color::RGB::gray(brightness).scaled(90).packed565();
-
-    uint16_t columnColors[columnCount];
-    for (int i = 0; i < columnCount; i++) {
-        columnColors[i] = Color::HSV(57600UL * i / columnCount, 255, brightness)
-            .toRGB()
-            .packed565();
-    }    
+    const Color::RGB defaultDotColor = Color::RGB::gray(255).scaled(90);
 
     for (int columnIndex = 0; columnIndex < columnCount; columnIndex++) {
-        int xDisplay;
+        const ColumnPixels& pixels = columnPixels[columnIndex];
+        const Color::RGB& barColor = useCustomColor ? rgbOverride : columnColors[columnIndex];
 
-        // Skip the middle two columns
-        if (columnIndex <= 7) {
-            xDisplay = columnIndex;
-        }
-        else {
-            xDisplay = columnIndex + 2;
+        // The bar runs from its top down past the bottom of the matrix.
+        for (int16_t y = pixels.top; y < GlassesLayout::matrixHeight; y++) {
+            frame.setMatrixColor(columnIndex, y, barColor);
         }
 
-        float columnTop = spectrumizer.getColumnTop(columnIndex);
-        float columnDot = spectrumizer.getColumnDot(columnIndex);
+        const Color::RGB& dotColor = snowCapped ? defaultDotColor : barColor;
+        frame.setMatrixColor(columnIndex, pixels.dot, dotColor);
+    }
 
-        uint16_t barColor = useCustomColor ? rgbOverride : columnColors[columnIndex];
-        glasses.drawLine(xDisplay, columnTop, xDisplay, columnTop + 20, barColor);
+    for (int i = 0; i < ringPixelCount; i++) {
+        const Color::RGB& ringColor = useCustomColor ? rgbOverride : ringColors[i];
+        Color::RGB c = ringColor.scaled(ringBrightness[i]);
 
-        uint16_t yDot = min(columnDot, 4);
-        uint16_t dotColor = snowCapped ? defaultDotColor : barColor;
-        glasses.drawPixel(xDisplay, yDot, dotColor);
+        frame.setLeftRingColor(i, c);
+        frame.setRightRingColor(i, c);
     }
 
+    glasses.load(frame);
     glasses.show();    
 }
 
+void AudioBarsScene::analyzeRings(const AudioFeatures& features) {
+    const uint16_t* bands = ringBands.getBands();
+    uint16_t ceiling = features.spectrumCeiling;
+
+    int32_t lower = bands[0];
+    for (int i = 1; i < ringPixelCount; i++) {
+        lower = min(lower, int32_t(bands[i]));
+    }
+
+    float range = max(int32_t(ceiling) - lower, int32_t(128));
+    float levels[ringPixelCount];
+
+    for (int i = 0; i < ringPixelCount; i++) {
+        levels[i] = constrain((int32_t(bands[i]) - lower) / range, 0.0f, 1.0f);
+    }
+
+    ringLevels.push(levels, features.timeMs);
+}
+
 void AudioBarsScene::exit() {
+    getDevice().audioAnalyzer.setLongWindowEnabled(false);
+    getDevice().audioAnalyzer.setSpectrumEnabled(false);
     getDevice().pdmRecorder.stopRecording();
 }
 
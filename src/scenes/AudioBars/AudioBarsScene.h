@@ -6,8 +6,17 @@
 
 #include <Arduino.h>
 #include "Scene.h"
-#include "ColumnSpectrumizer.h"
-#include "PdmRecorder.h"
+#include "ColumnBars.h"
+#include "LogFilterbank.h"
+#include "InterpolatedBands.h"
+#include "AudioAnalyzer.h"
+#include "GlassesBuffer.h"
+
+// #define AUDIO_BARS_FFT_BENCHMARK
+
+#if defined(AUDIO_BARS_FFT_BENCHMARK)
+#include "FftBenchmark.h"
+#endif
 
 class AudioBarsScene: public Scene {
 public:
@@ -16,15 +25,50 @@ public:
 
     virtual void enter() override;
     virtual void exit() override;
-    virtual void update(uint32_t dt);
+    virtual void update(uint32_t dt) override;
+    virtual void fixedUpdate(uint32_t dt) override;
+    virtual void draw() override;
     virtual void receivedColor(const Color::RGB& c) override;
 
-private:
-    void draw();
+    // The dots fall in fixed steps.
+    virtual uint16_t fixedTimestep() const override { return ColumnBars<GlassesBuffer::matrixWidth>::fallStepMs; }
 
 private:
-    static constexpr int columnCount = 16;
-    ColumnSpectrumizer<columnCount, PdmRecorder::sampleCount> spectrumizer;
+    // The whole width of the matrix, and every pixel of the rings,
+    // from the same analysis.
+    static constexpr int columnCount = GlassesBuffer::matrixWidth;
+    static constexpr int ringPixelCount = GlassesBuffer::ringPixelCount;
+    static constexpr uint16_t lowHz = 50;
+    static constexpr uint16_t highHz = 5000;
+
+    LogFilterbank<columnCount, lowHz, highHz> columnBands;
+    LogFilterbank<ringPixelCount, lowHz, highHz> ringBands;
+    ColumnBars<columnCount> bars;
+    uint32_t featuresVersion = 0;
+
+    #if defined(AUDIO_BARS_FFT_BENCHMARK)
+    FftBenchmark<AudioFeatures::windowSize> fftBenchmark;
+    uint32_t benchmarkElapsed = 0;
+    #endif
+    Color::RGB columnColors[columnCount];
+    GlassesBuffer frame;
+
+    // Where each column's bar top and dot land on the matrix,
+    // so we only redraw when one of them moves.
+    struct ColumnPixels {
+        int8_t top = GlassesBuffer::matrixHeight;
+        uint8_t dot = GlassesBuffer::matrixHeight - 1;
+    };
+
+    ColumnPixels columnPixels[columnCount];
+
+    // Each ring pixel glows with its band, smoothed and interpolated like the bars.
+    static constexpr float ringSmoothingMs = 35;
+    Color::RGB ringColors[ringPixelCount];
+    InterpolatedBands<ringPixelCount> ringLevels{ringSmoothingMs};
+    uint8_t ringBrightness[ringPixelCount] = {};
+
+    void analyzeRings(const AudioFeatures& features);
 
     bool useCustomColor = false;
     float hue = 0;
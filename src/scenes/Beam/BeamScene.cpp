@@ -7,7 +7,7 @@
 BeamScene::BeamScene(Device& d)
     : Scene(d)
 {
-    
+    compositor.setBlendMode(beamLayer, GlassesCompositor<2>::BlendMode::max);
 }
 
 void BeamScene::gotoNextBeamMode() {
@@ -33,6 +33,8 @@ void BeamScene::enter() {
     xCurrent = xBeam = glasses.width() / 2;
     yCurrent = yBeam = glasses.height() / 2;
 
+    glasses.output().configure(100, 200);
+
     beamMode = BeamMode(settings.beamMode());
     hue = settings.beamHue();
     saturation = settings.beamSaturation();
@@ -42,7 +44,10 @@ void BeamScene::enter() {
 
 void BeamScene::update(uint32_t dt) {
     beamFSM.update(dt);
+    beamFSM.transition();
+}
 
+void BeamScene::fixedUpdate(uint32_t dt) {
     if (instant) {
         xCurrent = xBeam;
         yCurrent = yBeam;
@@ -69,33 +74,58 @@ void BeamScene::update(uint32_t dt) {
         }
     }
 
-    draw();
-    beamFSM.transition();
+    // The beam is left behind in the trail, which fades out over time.
+    GlassesBuffer& trail = compositor.layer(trailLayer);
+    plotBeam(trail, Color::HSV(int(hue), saturation, 255).toRGB());
+    trail.fadeMatrix(fade);
+
+    BeamLook look;
+    look.x = int32_t(xCurrent);
+    look.y = int32_t(yCurrent);
+    look.mode = beamMode;
+    look.hue = hue;
+    look.saturation = saturation;
+    look.fade = fade;
+
+    if (look != lastLook) {
+        lastLook = look;
+        trailStepsLeft = trailFadeSteps();
+    }
+
+    if (trailStepsLeft > 0) {
+        trailStepsLeft--;
+        invalidate();
+    }
 }
 
 void BeamScene::draw() {
     Glasses& glasses = getDevice().glasses;
-    Settings& settings = getDevice().settings;
 
+    GlassesBuffer& beam = compositor.layer(beamLayer);
+    beam.clear();
+    plotBeam(beam, Color::HSV(int(hue), saturation, 255).toRGB());
+
+    compositor.resolve(frame);
+    glasses.load(frame);
+    glasses.show();
+}
+
+void BeamScene::plotBeam(GlassesBuffer& buffer, const Color::RGB& color) {
     int32_t x = int32_t(xCurrent);
     int32_t y = int32_t(yCurrent);
 
-    uint8_t brightness = map(settings.sceneBrightness(), 0, 255, 100, 200);
-    // Serial.printf("%d, %d\n", settings.sceneBrightness(), brightness);
-    Color::RGB beamColor = Color::HSV(int(hue), saturation, brightness).toRGB();
-
     switch (beamMode) {
         case BeamMode::vertical: {
             // Subtract one from height to exclude the row that's missing 2 pixels in the middle.
-            for (int i = 0; i < glasses.height(); i++) {
-                glassesBuffer.setMatrixColor(x, i, beamColor);
+            for (int i = 0; i < GlassesBuffer::matrixHeight; i++) {
+                buffer.setMatrixColor(x, i, color);
             }
         }
         break;
 
         case BeamMode::horizontal: {
-            for (int i = 0; i < glasses.width(); i++) {
-                glassesBuffer.setMatrixColor(i, y, beamColor);
+            for (int i = 0; i < GlassesBuffer::matrixWidth; i++) {
+                buffer.setMatrixColor(i, y, color);
             }
         }
         break;
@@ -107,8 +137,8 @@ void BeamScene::draw() {
                 if (x <= 0) {
                     x = 1;
                 } 
-                else if (x >= glasses.width() - 1) {
-                    x = glasses.width() - 2;
+                else if (x >= GlassesBuffer::matrixWidth - 1) {
+                    x = GlassesBuffer::matrixWidth - 2;
                 }                            
             }
 
@@ -118,21 +148,20 @@ void BeamScene::draw() {
                 y = 3;
             }
 
-            glassesBuffer.setMatrixColor(x, y, beamColor);
+            buffer.setMatrixColor(x, y, color);
         }
         break;        
     };
+}
 
-    glassesBuffer.fadeMatrix(fade);
+uint16_t BeamScene::trailFadeSteps() const {
+    uint16_t steps = 0;
 
-    for (int px = 0; px < GlassesBuffer::matrixWidth; px++) {
-        for (int py = 0; py < GlassesBuffer::matrixHeight; py++) {
-            uint16_t c = glassesBuffer.getMatrixColor(px, py).gammaApplied().packed565();
-            glasses.drawPixel(px, py, c);
-        }
+    for (uint8_t c = 255; c > 0 && fade < 255; c = Color::scale8(c, fade)) {
+        steps++;
     }
 
-    glasses.show();
+    return steps + 1;
 }
 
 void BeamScene::gamepadConnected() {
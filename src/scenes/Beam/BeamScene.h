@@ -24,6 +24,8 @@ public:
 
     virtual void enter() override;
     virtual void update(uint32_t dt) override;
+    virtual void fixedUpdate(uint32_t dt) override;
+    virtual void draw() override;
     virtual void gamepadConnected() override;
     virtual void gamepadDisconnected() override;
     virtual void receivedColor(const Color::RGB& c) override;
@@ -42,15 +44,44 @@ public:
 
     FSM beamFSM;
 
+    // The beam's motion and trail are stepped at a fixed rate,
+    // so the trail's length doesn't depend on the frame rate.
+    virtual uint16_t fixedTimestep() const override { return 10; }
+
 private:
-    void draw();
+    void plotBeam(GlassesBuffer& buffer, const Color::RGB& color);
+    uint16_t trailFadeSteps() const;
 
 private:
-    GlassesBuffer glassesBuffer;
+    // The trail fades out over time, while the beam itself
+    // is drawn fresh on top of it each frame.
+    static constexpr uint8_t trailLayer = 0;
+    static constexpr uint8_t beamLayer = 1;
+    GlassesCompositor<2> compositor;
+    GlassesBuffer frame;
 
     const float xSpeed = 80.0;
     const float ySpeed = 60.0;
 
     float xCurrent = 0;
     float yCurrent = 0;
+
+    // What the beam looked like last step. When it stops changing,
+    // we only need to redraw until the trail fades out.
+    struct BeamLook {
+        int32_t x = -1;
+        int32_t y = -1;
+        BeamMode mode = BeamMode::vertical;
+        uint16_t hue = 0;
+        uint8_t saturation = 0;
+        uint8_t fade = 0;
+
+        bool operator!=(const BeamLook& other) const {
+            return x != other.x || y != other.y || mode != other.mode ||
+                hue != other.hue || saturation != other.saturation || fade != other.fade;
+        }
+    };
+
+    BeamLook lastLook;
+    uint16_t trailStepsLeft = 0;
 };
\ No newline at end of file
@@ -4,12 +4,15 @@
 #include "Color.h"
 
 namespace {
-    void drawRingPixel(Adafruit_EyeLights_Ring_buffered& ring, uint8_t index, const Color::RGB& color, float scale) {
+    // Either GlassesBuffer::setLeftRingColor or GlassesBuffer::setRightRingColor.
+    typedef void (GlassesBuffer::*RingPixelSetter)(uint32_t index, const Color::RGB& c);
+
+    void drawRingPixel(GlassesBuffer& frame, RingPixelSetter setPixel, uint8_t index, const Color::RGB& color, float scale) {
         uint8_t s = scale * 255;
-        ring.setPixelColor(index, color.scaled(s).gammaApplied().packed());
+        (frame.*setPixel)(index, color.scaled(s));
     }    
 
-    void drawRing(Pendulum& pendlum, Adafruit_EyeLights_Ring_buffered& ring, const Color::RGB& color) {
+    void drawRing(Pendulum& pendlum, GlassesBuffer& frame, RingPixelSetter setPixel, const Color::RGB& color) {
         // Scale pendulum angle into pixel space
         float midpoint = fmodf(pendlum.getAngle() * 12.0 / M_PI, 24.0);
 
@@ -28,17 +31,17 @@ namespace {
             // Not close to pendulum,
             if (dist > 5.0) {
                 // erase pixel.
-                ring.setPixelColor(i, 0);
+                (frame.*setPixel)(i, Color::RGB());
             }
             // Close to pendulum,
             else if (dist < 1.0) {
                 // solid color
-                drawRingPixel(ring, i, color, 1.0);
+                drawRingPixel(frame, setPixel, i, color, 1.0);
             }
             // Anything in-between, 
             else {
                 // interpolate
-                drawRingPixel(ring, i, color, (5.0 - dist) / 4.0);
+                drawRingPixel(frame, setPixel, i, color, (5.0 - dist) / 4.0);
             }
         }        
     }
@@ -49,6 +52,8 @@ GooglyRingsScene::GooglyRingsScene(Device& device) :
 }
 
 void GooglyRingsScene::enter() {
+    getDevice().glasses.output().configure(80, 240);
+
     Settings& settings = getDevice().settings;
     hue = settings.googlyRingsHue();
     saturation = settings.googlyRingsSaturation();
@@ -58,18 +63,30 @@ void GooglyRingsScene::enter() {
 
 void GooglyRingsScene::update(uint32_t dt) {
     fsm.update(dt);
-    draw();
+}
+
+void GooglyRingsScene::fixedUpdate(uint32_t dt) {
+    fsm.fixedUpdate(dt);
+
+    // Once the pendulums come to rest, there's nothing new to draw.
+    if (fabsf(leftPendulum.getAngle() - drawnLeftAngle) >= minAngleChange ||
+        fabsf(rightPendulum.getAngle() - drawnRightAngle) >= minAngleChange)
+    {
+        invalidate();
+    }
 }
 
 void GooglyRingsScene::draw() {
     Glasses& glasses = getDevice().glasses;
-    Settings& settings = getDevice().settings;
 
-    uint8_t brightness = map(settings.sceneBrightness(), 0, 255, 80, 240);
-    // Serial.printf("%d, %d\n", settings.sceneBrightness(), brightness);
-    Color::RGB color = Color::HSV(hue, saturation, brightness).toRGB();
-    drawRing(leftPendulum, glasses.left_ring, color);
-    drawRing(rightPendulum, glasses.right_ring, color);
+    Color::RGB color = Color::HSV(hue, saturation, 255).toRGB();
+    drawRing(leftPendulum, frame, &GlassesBuffer::setLeftRingColor, color);
+    drawRing(rightPendulum, frame, &GlassesBuffer::setRightRingColor, color);
+
+    drawnLeftAngle = leftPendulum.getAngle();
+    drawnRightAngle = rightPendulum.getAngle();
+
+    glasses.load(frame);
     glasses.show();
 }
 
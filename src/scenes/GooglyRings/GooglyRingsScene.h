@@ -7,6 +7,7 @@
 #include "Scene.h"
 #include "FSM.h"
 #include "Pendulum.h"
+#include "GlassesBuffer.h"
 
 class GooglyRingsScene: public Scene {
 public:
@@ -14,7 +15,9 @@ public:
     virtual ~GooglyRingsScene() = default;
 
     virtual void enter() override;
-    virtual void update(uint32_t dt);
+    virtual void update(uint32_t dt) override;
+    virtual void fixedUpdate(uint32_t dt) override;
+    virtual void draw() override;
     virtual void gamepadConnected() override;
     virtual void gamepadDisconnected() override;
     virtual void receivedColor(const Color::RGB& c) override;
@@ -25,6 +28,17 @@ public:
     float hue = (65536 / 6) * 5;
     uint8_t saturation = 255;
 
+    // The pendulums don't factor time into their simulation, so step them at a
+    // fixed rate, and there's nothing new to draw any faster than that.
+    virtual uint16_t frameRate() const override { return 30; }
+    virtual uint16_t fixedTimestep() const override { return 33; }
+
 private:
-    void draw();
+    // About the smallest swing that changes a pixel's brightness
+    // (24 pixels around the ring, interpolated over 4 of them).
+    static constexpr float minAngleChange = (2.0 * M_PI / 24.0) * (4.0 / 255.0);
+
+    GlassesBuffer frame;
+    float drawnLeftAngle = 0;
+    float drawnRightAngle = 0;
 };
@@ -20,40 +20,36 @@ namespace {
 void GooglyRings_Connected::enter() {
     Glasses& glasses = getDevice().glasses;
     glasses.fill(0);
-
-    frameElapsed = frameInterval;
 }
 
-void GooglyRings_Connected::update(uint32_t dt) {
+void GooglyRings_Connected::fixedUpdate(uint32_t dt) {
     Gamepad& gamepad = getDevice().gamepad;
     Gamepad::Report report = gamepad.getReport();    
 
-    frameElapsed += dt;
-
-    while (frameElapsed >= frameInterval) {
-        frameElapsed -= frameInterval;
+    // Downward by default.
+    float ax = raw2accel(350);
+    float az = raw2accel(512);
 
-        // Downward by default.
-        float ax = raw2accel(350);
-        float az = raw2accel(512);
+    // Press z to "grab" the pendulums and move them by rotating the nunchuck on the x axis.
+    if (gamepad.isDown(gamepad.buttonZ)) {
+        ax = raw2accel(1023 - report.az);
+        az = raw2accel(report.ax);
+    }
+    // Or, you can use the analog stick to pull the pendulums.
+    else if (abs(report.x) > 0 || abs(report.y) > 0) {
+        // Mimic nunchuck accelerometer values.
+        int32_t jx = map(report.x, -127, 127, 350, 700);
+        int32_t jy = map(report.y, -127, 127, 350, 700);
+        ax = raw2accel(jy);
+        az = raw2accel(jx);
+    }
 
-        // Press z to "grab" the pendulums and move them by rotating the nunchuck on the x axis.
-        if (gamepad.isDown(gamepad.buttonZ)) {
-            ax = raw2accel(1023 - report.az);
-            az = raw2accel(report.ax);
-        }
-        // Or, you can use the analog stick to pull the pendulums.
-        else if (abs(report.x) > 0 || abs(report.y) > 0) {
-            // Mimic nunchuck accelerometer values.
-            int32_t jx = map(report.x, -127, 127, 350, 700);
-            int32_t jy = map(report.y, -127, 127, 350, 700);
-            ax = raw2accel(jy);
-            az = raw2accel(jx);
-        }
+    scene.leftPendulum.step(ax, az);
+    scene.rightPendulum.step(ax, az);                    
+}
 
-        scene.leftPendulum.step(ax, az);
-        scene.rightPendulum.step(ax, az);                    
-    }
+void GooglyRings_Connected::update(uint32_t dt) {
+    Gamepad& gamepad = getDevice().gamepad;
 
     if (gamepad.isDown(gamepad.buttonC)) {
         scene.hue += dt * 10;
@@ -62,6 +58,8 @@ void GooglyRings_Connected::update(uint32_t dt) {
         if (scene.hue >= 65535) {
             scene.hue = 0.0;
         }
+
+        scene.invalidate();
     }    
     else if (gamepad.wasReleased(gamepad.buttonC)) {
         Settings& settings = getDevice().settings;
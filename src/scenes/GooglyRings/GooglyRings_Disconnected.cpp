@@ -4,19 +4,15 @@
 
 void GooglyRings_Disconnected::enter() {
     getDevice().glasses.fill(0);
-    frameElapsed = frameInterval;
 }
 
-void GooglyRings_Disconnected::update(uint32_t dt) {
-    frameElapsed += dt;
+void GooglyRings_Disconnected::fixedUpdate(uint32_t dt) {
+    // The accelerometer shares the I2C bus with the glasses.
+    getDevice().glasses.waitForTransfer();
 
-    while (frameElapsed >= frameInterval) {
-        frameElapsed -= frameInterval;
+    sensors_event_t event;
+    getDevice().accel.getEvent(&event);
 
-        sensors_event_t event;
-        getDevice().accel.getEvent(&event);
-
-        scene.leftPendulum.step(event.acceleration.x, event.acceleration.z);
-        scene.rightPendulum.step(event.acceleration.x,event.acceleration.z);
-    }
+    scene.leftPendulum.step(event.acceleration.x, event.acceleration.z);
+    scene.rightPendulum.step(event.acceleration.x,event.acceleration.z);
 }
@@ -16,10 +16,5 @@ public:
     virtual ~GooglyRings_Disconnected() = default;
 
     virtual void enter() override;
-    virtual void update(uint32_t) override;
-
-private:
-    // Fixed timestep since pendulum does not factor time into simulation.    
-    static constexpr uint32_t frameInterval = 33;
-    uint32_t frameElapsed = 0;
+    virtual void fixedUpdate(uint32_t) override;
 };
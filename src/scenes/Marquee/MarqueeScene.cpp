@@ -31,8 +31,7 @@ void MarqueeScene::update(uint32_t dt) {
     Settings& settings = getDevice().settings;    
     Gamepad& gamepad = getDevice().gamepad;
     SoftGamepad& softGamepad = getDevice().softGamepad;
-    Glasses& glasses = getDevice().glasses;
-    GFXcanvas16* canvas = glasses.getCanvas();
+    GFXcanvas16* canvas = getDevice().glasses.getCanvas();
 
     // Update color
     if (gamepad.isDown(gamepad.buttonC)) {
@@ -43,6 +42,8 @@ void MarqueeScene::update(uint32_t dt) {
         if (hue >= 65535.0) {
             hue = 0.0;
         }
+
+        invalidate();
     }
     else if (gamepad.wasReleased(gamepad.buttonC)) {
         settings.marqueeSetUseCustomColor(useCustomColor);
@@ -52,6 +53,7 @@ void MarqueeScene::update(uint32_t dt) {
     else if (gamepad.wasPressed(gamepad.buttonZ)) {
         useCustomColor = false;        
         settings.marqueeSetUseCustomColor(useCustomColor);
+        invalidate();
     }
 
     // Update scroll speed
@@ -79,42 +81,50 @@ void MarqueeScene::update(uint32_t dt) {
         settings.marqueeSetScrollDelay(scrollDelay);
     }
 
-    // Update scroll
-    scrollElapsed += dt;
+    // Update scroll, faster with the music.
+    scrollElapsed += getDevice().modulation.apply(ModulationMatrix::speed, dt) + 0.5f;
 
     if (scrollElapsed >= scrollDelay) {
         scrollElapsed = fmod(scrollElapsed, scrollDelay);
 
-        canvas->fillScreen(0);
-        canvas->setCursor(scrollPosition, canvas->height());
-
-        uint8_t brightness = map(settings.sceneBrightness(), 0, 255, 100, 255);
-        // Serial.printf("%d, %d\n", settings.sceneBrightness(), brightness);
-
-        uint32_t len = strlen(messageBuffer);
-
-        if (useCustomColor) {
-            canvas->setTextColor(Color::HSV(hue, saturation, brightness).toRGB().packed565());
-            canvas->print(messageBuffer);
-        } 
-        else {
-            for (unsigned int i = 0; i < len; i++) {
-                uint16_t h = (startHue + (i * 4096)) & 0xFFFF;
-                uint16_t c = Color::HSV(h, 255, brightness).toRGB().packed565();
-                canvas->setTextColor(c);
-                canvas->write(messageBuffer[i]);
-            }            
-        }
-
-        glasses.scale();
-        glasses.show();
-
         scrollPosition--;
         if( scrollPosition < -messageWidth) {
             scrollPosition = canvas->width();
-            startHue = (startHue + (len * 4096)) & 0xFFFF;
+            startHue = (startHue + (strlen(messageBuffer) * 4096)) & 0xFFFF;
         }
+
+        // Between scroll steps, the text doesn't move.
+        invalidate();
+    }
+}
+
+void MarqueeScene::draw() {
+    Glasses& glasses = getDevice().glasses;
+    GFXcanvas16* canvas = glasses.getCanvas();
+
+    canvas->fillScreen(0);
+    canvas->setCursor(scrollPosition, canvas->height());
+
+    // Drawn through the canvas, so the scene brightness (as modulated) is applied here.
+    uint8_t brightness = map(glasses.output().getSceneBrightness(), 0, 255, 100, 255);
+
+    uint32_t len = strlen(messageBuffer);
+
+    if (useCustomColor) {
+        canvas->setTextColor(Color::HSV(hue, saturation, brightness).toRGB().packed565());
+        canvas->print(messageBuffer);
+    } 
+    else {
+        for (unsigned int i = 0; i < len; i++) {
+            uint16_t h = (startHue + (i * 4096)) & 0xFFFF;
+            uint16_t c = Color::HSV(h, 255, brightness).toRGB().packed565();
+            canvas->setTextColor(c);
+            canvas->write(messageBuffer[i]);
+        }            
     }
+
+    glasses.scale();
+    glasses.show();
 }
 
 void MarqueeScene::receivedColor(const Color::RGB& c) {
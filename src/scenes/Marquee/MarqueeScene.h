@@ -14,10 +14,14 @@ public:
     virtual ~MarqueeScene() = default;
 
     virtual void enter() override;
-    virtual void update(uint32_t dt);
+    virtual void update(uint32_t dt) override;
+    virtual void draw() override;
     virtual void receivedColor(const Color::RGB& c) override;
     virtual void receivedText(const char* text) override;
 
+    // Fast enough to step the scroll at the shortest scroll delay.
+    virtual uint16_t frameRate() const override { return 100; }
+
 private:
     void resetScroll();
     uint8_t charWidth(uint8_t c) const;
@@ -32,6 +32,7 @@ void ShiftyEyesScene::update(uint32_t dt) {
     if (softGamepad.wasPressed(softGamepad.button1)) {
         hasMonsterPupils = !hasMonsterPupils;
         getDevice().settings.shiftyEyesSetHasMonsterPupils(hasMonsterPupils);
+        invalidate();
     }
 
     if (softGamepad.isDown(softGamepad.button2)) {
@@ -40,6 +41,8 @@ void ShiftyEyesScene::update(uint32_t dt) {
         if (pupilHue >= 65535.0) {
             pupilHue = 0.0;
         }        
+
+        invalidate();
     }
     else if (softGamepad.wasReleased(softGamepad.button2)) {
         settings.shiftyEyesSetPupilHue(pupilHue);
@@ -51,19 +54,22 @@ void ShiftyEyesScene::update(uint32_t dt) {
         if (ringHue >= 65535.0) {
             ringHue = 0.0;
         }        
+
+        invalidate();
     }
     else if (softGamepad.wasReleased(softGamepad.button3)) {
         settings.shiftyEyesSetRingHue(ringHue);
     }
 
-
     pupilsFSM.update(dt);
     eyelidsFSM.update(dt);
 
-    draw();
-
     pupilsFSM.transition();
     eyelidsFSM.transition();
+
+    if (xPupil != xPupilDrawn || yPupil != yPupilDrawn) {
+        invalidate();
+    }
 }
 
 void ShiftyEyesScene::draw() {
@@ -77,15 +83,18 @@ void ShiftyEyesScene::draw() {
 
     drawEyeOutlines();
     glasses.show();
+
+    xPupilDrawn = xPupil;
+    yPupilDrawn = yPupil;
 }
 
 void ShiftyEyesScene::drawPupils() {
     Glasses& glasses = getDevice().glasses;
     auto canvas = glasses.getCanvas();
 
-    Settings& settings = getDevice().settings;
-
-    uint8_t brightness = map(settings.sceneBrightness(), 0, 255, 180, 255);
+    // Drawn through the canvas, so the scene brightness (as modulated) is applied here.
+    uint8_t sceneBrightness = glasses.output().getSceneBrightness();
+    uint8_t brightness = map(sceneBrightness, 0, 255, 180, 255);
     uint16_t c = Color::HSV(pupilHue, 255, brightness).toRGB().gammaApplied().packed565();
     
     if (hasMonsterPupils) {
@@ -102,20 +111,16 @@ void ShiftyEyesScene::drawRingRow(uint8_t index, const Color::RGB& color) {
     Glasses& glasses = getDevice().glasses;
     const Rings::Row* row = Rings::getRow(index);
 
-    uint32_t c = color.packed();
-    
     for (uint8_t i = 0; i < row->numIndices; i++) {
-        glasses.left_ring.setPixelColor(row->indices[i], c);
-        glasses.right_ring.setPixelColor(row->indices[i], c);
+        glasses.setLeftRingPixel(row->indices[i], color);
+        glasses.setRightRingPixel(row->indices[i], color);
     }
 }
 
 void ShiftyEyesScene::drawEyeOutlines() {
     Glasses& glasses = getDevice().glasses;
-    Settings& settings = getDevice().settings;
-    
     uint8_t eyelidPosition = getEyelidPosition();
-    uint8_t brightness = map(settings.sceneBrightness()/2, 0, 128, 64, 128);
+    uint8_t brightness = map(glasses.output().getSceneBrightness()/2, 0, 128, 64, 128);
     Color::RGB ringColor = Color::HSV(ringHue, 255, brightness).toRGB().gammaApplied();
 
     // Fill in the rect between the rings, in case the pupils bleed over a little.
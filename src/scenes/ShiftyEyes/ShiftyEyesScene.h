@@ -12,7 +12,8 @@ public:
     virtual ~ShiftyEyesScene() = default;
 
     virtual void enter() override;
-    virtual void update(uint32_t dt);
+    virtual void update(uint32_t dt) override;
+    virtual void draw() override;
     virtual void gamepadConnected() override;
     virtual void gamepadDisconnected() override;
     virtual void receivedColor(const Color::RGB& c) override;
@@ -24,7 +25,12 @@ public:
     }
 
     void setEyelidPosition(uint8_t pos) {
-        eyelidPosition = min(pos, maxEyelidPosition);
+        pos = min(pos, maxEyelidPosition);
+
+        if (pos != eyelidPosition) {
+            eyelidPosition = pos;
+            invalidate();
+        }
     }
 
     bool hasMonsterPupils = false;
@@ -36,7 +42,6 @@ public:
     FSM eyelidsFSM;
 
 private:
-    void draw();
     void drawPupils();
     void drawRingRow(uint8_t index, const Color::RGB& color);
     void drawEyeOutlines();
@@ -47,4 +52,9 @@ private:
 
     // 0 = fully open, maxEyelidPosition = fully closed
     uint8_t eyelidPosition = 0;
+
+    // The pupils are moved directly by the states, so we check
+    // whether they moved since the last draw.
+    int8_t xPupilDrawn = -1;
+    int8_t yPupilDrawn = -1;
 };
\ No newline at end of file
@@ -3,6 +3,15 @@
 // #define LOGGER Serial
 #include "Logger.h"
 
+namespace {
+    // Louder music spawns sparkles sooner, and cycles through the colors faster.
+    const ModulationMatrix::Route routes[] = {
+        {ModulationMatrix::level, ModulationMatrix::density, ModulationMatrix::linear, 10},
+        {ModulationMatrix::level, ModulationMatrix::density, ModulationMatrix::cubed, 10},
+        {ModulationMatrix::level, ModulationMatrix::hueSpeed, ModulationMatrix::squared, 18},
+    };
+}
+
 SparklesScene::SparklesScene(Device& d)
     : Scene(d) 
 {
@@ -15,36 +24,45 @@ void SparklesScene::enter() {
     glasses.left_ring.fill(0);
     glasses.right_ring.fill(0);
 
+    glasses.output().configure(128, 255);
+
     Settings& settings = getDevice().settings;
     useCustomColor = settings.sparklesUseCustomColor();
     hue = settings.sparklesHue();
 
-    intensityInvScale = intensityMinInvScale;
-
     newSparkleTimer = 0;
 
     getDevice().pdmRecorder.startRecording();
+
+    // For the onsets.
+    AudioAnalyzer& audioAnalyzer = getDevice().audioAnalyzer;
+    audioAnalyzer.setSpectrumEnabled(true);
+    onsetCount = audioAnalyzer.features().onsetCount;
+
+    getDevice().modulation.setRoutes(routes, sizeof(routes) / sizeof(routes[0]));
 }
 
 void SparklesScene::update(uint32_t dt) {
     Gamepad& gamepad = getDevice().gamepad;
     Settings& settings = getDevice().settings;
+    const ModulationMatrix& modulation = getDevice().modulation;
 
-    // Use the same filtering trick as the bars scene, and apply 30% 
-    // of the last value to the current one to help prevent twitchiness.
-    float reading = max(getDevice().pdmRecorder.magnitude() - intensityDeadZone, 0);
-    float magnitude = (reading * 0.7) + (lastMagnitude * 0.3);
-    lastMagnitude = magnitude;
+    // The analyzer's gain control has already scaled the level to the room.
+    const AudioFeatures& features = getDevice().audioAnalyzer.features();
+    float intensity = intensityMin + features.level * (intensityMax - intensityMin);
 
-    float intensity = intensityMin + (magnitude / intensityInvScale) * (intensityMax - intensityMin);
-    intensity = min(intensity, intensityMax);
+    // Spawn right away on every onset, instead of waiting for the timer.
+    if (features.onsetCount != onsetCount) {
+        onsetCount = features.onsetCount;
+        newSparkleTimer = 0;
+    }
 
     // speed up spawn time depending on intensity.
-    uint32_t dtScaled = dt + (dt * intensity * 10) + (dt * intensity * intensity * intensity * 10);
+    uint32_t dtScaled = modulation.apply(ModulationMatrix::density, dt);
     newSparkleTimer -= dtScaled;
 
     // Speed up color change based on intensity.
-    currentHue += dt + (intensity * intensity * 300);
+    currentHue += modulation.apply(ModulationMatrix::hueSpeed, dt);
     if (currentHue >= 65536.0) {
         currentHue -= 65536.0;
     }
@@ -69,10 +87,9 @@ void SparklesScene::update(uint32_t dt) {
     if (newSparkleTimer <= 0) {
         newSparkleTimer = random(minSpawnInterval, maxSpawnInterval);
 
-        // Brighten sparkle based on intensity.
-        uint8_t maxBrightness = map(settings.sceneBrightness(), 0, 255, 128, 255);
-        uint8_t minBrightness = maxBrightness / 2;
-        // Serial.printf("%d, %d, %d\n", settings.sceneBrightness(), minBrightness, maxBrightness);                
+        // Brighten sparkle based on intensity. The scene brightness is applied on output.
+        const uint8_t maxBrightness = 255;
+        const uint8_t minBrightness = maxBrightness / 2;
         uint16_t brightness = minBrightness + (intensity * intensity * (maxBrightness - minBrightness));
 
         // The higher the intensity, the more sparkles spawn.
@@ -93,6 +110,8 @@ void SparklesScene::update(uint32_t dt) {
             continue;
         }
 
+        // Active sparkles fade every frame, and need one more once they go out.
+        invalidate();
         sparkle.timeToLive -= dt;
 
         if (sparkle.timeToLive <= 0) {
@@ -108,26 +127,14 @@ void SparklesScene::update(uint32_t dt) {
             numActive++;
         }
     }
-    LOGFMT("sparkles: %d, magnitude: %.02f, invScale: %.02f, intensity: %.02f, dt: %d, dtScaled: %d\n", numActive, magnitude, intensityInvScale, intensity, dt, dtScaled);
+    LOGFMT("sparkles: %d, rms: %.02f, intensity: %.02f, dt: %d, dtScaled: %d\n", numActive, features.rms, intensity, dt, dtScaled);
     #endif
-
-    draw();    
-
-    if (magnitude > intensityInvScale) {
-        // Increase the intensity scale
-        intensityInvScale += dt * (magnitude - intensityInvScale) * 0.02;
-    } 
-    else if (magnitude < intensityInvScale) {
-        // Decrease the intensity scale
-        intensityInvScale -= dt * (intensityInvScale - magnitude) * 0.002;
-        intensityInvScale = max(intensityInvScale, intensityMinInvScale);
-    }
 }
 
 void SparklesScene::draw() {
     Glasses& glasses = getDevice().glasses;
 
-    glasses.fill(0);
+    frame.clear();
 
     for (int i = 0; i < maxSparkles; i++) {
         Sparkle& sparkle = sparkles[i];
@@ -135,15 +142,17 @@ void SparklesScene::draw() {
         if (sparkle.isActive) {
             uint8_t scale = map(sparkle.timeToLive, 0, sparkle.duration, 32, 255);
             Color::RGB c = sparkle.hsv.toRGB().scaled(scale);
-            glasses.drawPixel(sparkle.x, sparkle.y, c.gammaApplied().packed565());            
+            frame.setMatrixColor(sparkle.x, sparkle.y, c);
 
         }
     }
 
+    glasses.load(frame);
     glasses.show();
 }
 
 void SparklesScene::exit() {
+    getDevice().audioAnalyzer.setSpectrumEnabled(false);
     getDevice().pdmRecorder.stopRecording();
 }
 
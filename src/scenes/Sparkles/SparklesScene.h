@@ -3,6 +3,7 @@
 #include <Arduino.h>
 #include "Scene.h"
 #include "Color.h"
+#include "GlassesBuffer.h"
 
 class SparklesScene: public Scene {
 public:
@@ -11,18 +12,14 @@ public:
 
     virtual void enter() override;
     virtual void exit() override;
-    virtual void update(uint32_t dt);
+    virtual void update(uint32_t dt) override;
+    virtual void draw() override;
     virtual void receivedColor(const Color::RGB& c) override;
 
 private:
-    void draw();
     void newSparkle(const Color::HSV& hsv, int16_t ttl);
 
 private:
-    static constexpr float intensityDeadZone = 10.0;
-
-    static constexpr float intensityMinInvScale = 75.0;
-
     static constexpr float intensityMin = 0.0;
     static constexpr float intensityMax = 1.0;
 
@@ -45,9 +42,9 @@ private:
 
     static constexpr uint16_t maxSparkles = 255;
     Sparkle sparkles[maxSparkles];
+    GlassesBuffer frame;
     int32_t newSparkleTimer = 0;
-    float intensityInvScale = intensityMinInvScale;
-    float lastMagnitude = 0;
+    uint32_t onsetCount = 0;
     float currentHue = 0;
 
     bool useCustomColor = false;
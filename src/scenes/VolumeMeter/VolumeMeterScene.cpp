@@ -4,12 +4,33 @@
 VolumeMeterScene::VolumeMeterScene(Device& d)
     : Scene(d) 
 {
+    // Green to yellow to red, around the ring. Brightness is applied on output.
+    for (int i = 0; i < GlassesBuffer::ringPixelCount; i++) {
+        uint8_t r = 0;
+        uint8_t g = 0;
+
+        if (i < 12) {
+            g = 255;
+            r = map(i, 0, 12, 0, 255);
+        } else {
+            g = map(i, 12, 24, 255, 0);
+            r = 255;
+        }
 
+        gradient[i] = Color::RGB(r, g, 0);
+    }
 }
 
 void VolumeMeterScene::enter() {
-    getDevice().glasses.fill(0);
-    getDevice().pdmRecorder.startRecording();
+    getDevice().glasses.output().configure(64, 255);
+
+    // Only the loudness is used, which doesn't need 16 kHz or frequent blocks.
+    // 64 samples at 4 kHz is a callback every 16 ms, with 256 samples to average
+    // down, the most the PDM library can buffer, so the interrupts are as few as can be.
+    RecordingSettings recording;
+    recording.decimation = 4;
+    recording.blockSize = 64;
+    getDevice().pdmRecorder.startRecording(recording);
 
     Settings& settings = getDevice().settings;
     useCustomColor = settings.volumeMeterUseCustomColor();
@@ -19,14 +40,17 @@ void VolumeMeterScene::enter() {
 
 void VolumeMeterScene::update(uint32_t dt) {
     Gamepad& gamepad = getDevice().gamepad;
-    PdmRecorder& pdmRecorder = getDevice().pdmRecorder;
     Settings& settings = getDevice().settings;
 
-    // Use the same filtering trick as the bars scene, and apply 30% 
-    // of the last value to the current one to help prevent twitchiness.
-    float reading = max(pdmRecorder.magnitude() - deadZone, 0);
-    magnitude = (reading * 0.7) + (lastMagnitude * 0.3);
-    lastMagnitude = magnitude;
+    // The analyzer's gain control has already scaled the level to the room.
+    float level = getDevice().audioAnalyzer.features().level;
+    float value = minValue + level * (maxValue - minValue);
+
+    // In silence, this hardly ever changes.
+    if (uint8_t(value) != numLights) {
+        numLights = value;
+        invalidate();
+    }
 
     if (gamepad.isDown(gamepad.buttonC)) {
         useCustomColor = true;
@@ -36,6 +60,8 @@ void VolumeMeterScene::update(uint32_t dt) {
         if (hue >= 65535.0) {
             hue = 0.0;
         }
+
+        invalidate();
     }
     else if (gamepad.wasReleased(gamepad.buttonC)) {
         settings.volumeMeterSetUseCustomColor(useCustomColor);
@@ -46,53 +72,29 @@ void VolumeMeterScene::update(uint32_t dt) {
     else if (gamepad.wasPressed(gamepad.buttonZ)) {
         useCustomColor = false;
         settings.volumeMeterSetUseCustomColor(useCustomColor);
+        invalidate();
     }    
-
-    draw();
 }
 
 void VolumeMeterScene::draw() {
     Glasses& glasses = getDevice().glasses;
-    Settings& settings = getDevice().settings;
 
-    float value = minValue + (magnitude / invScale) * (maxValue - minValue);
-    value = min(value, maxValue);
-    uint8_t numLights = (uint8_t)value;
-    // Serial.printf("mag: %f, value: %f, numLights: %d\n", magnitude, value, numLights);
-    uint8_t brightness = map(settings.sceneBrightness(), 0, 255, 64, 255);
-    // Serial.printf("%d, %d\n", settings.sceneBrightness(), brightness);
-    uint32_t rgbOverride = Color::HSV(hue, saturation, brightness).toRGB().gammaApplied().packed();
+    Color::RGB rgbOverride = Color::HSV(hue, saturation, 255).toRGB();
 
-    glasses.left_ring.fill(0);
-    glasses.right_ring.fill(0);
+    frame.clear();
 
     for (int i = 0; i < numLights; i++) {
-        uint32_t c = 0;
-
-        if (useCustomColor) {
-            c = rgbOverride;
-        } else {
-            uint8_t r = 0;
-            uint8_t g = 0;
-
-            if (i < 12) {
-                g = 255;
-                r = map(i, 0, 12, 0, 255);
-            } else {
-                g = map(i, 12, 24, 255, 0);
-                r = 255;
-            }
-
-            c = Color::RGB(r, g, 0).scaled(brightness).gammaApplied().packed();
-        }
+        const Color::RGB& c = useCustomColor ? rgbOverride : gradient[i];
 
         uint8_t leftIndex = ((23 - i) + 6) % 24;
-        glasses.left_ring.setPixelColor(leftIndex, c);
+        frame.setLeftRingColor(leftIndex, c);
 
         uint8_t rightIndex = (24 - leftIndex) % 24;
-        glasses.right_ring.setPixelColor(rightIndex, c);
+        frame.setRightRingColor(rightIndex, c);
     }
 
+    glasses.load(frame);
+
     glasses.show();    
 }
 
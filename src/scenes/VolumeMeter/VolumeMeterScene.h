@@ -5,6 +5,7 @@
 
 #include <Arduino.h>
 #include "Scene.h"
+#include "GlassesBuffer.h"
 
 class VolumeMeterScene: public Scene {
 public:
@@ -13,20 +14,18 @@ public:
 
     virtual void enter() override;
     virtual void exit() override;
-    virtual void update(uint32_t dt);
+    virtual void update(uint32_t dt) override;
+    virtual void draw() override;
     virtual void receivedColor(const Color::RGB& c) override;
 
 private:
-    void draw();
-
-private:
-    static constexpr float deadZone = 10.0;
-    static constexpr float invScale = 175.0;
     static constexpr float minValue = 1.0;
     static constexpr float maxValue = 24.0;    
 
-    float lastMagnitude = 0.0;
-    float magnitude = 0.0;
+    Color::RGB gradient[GlassesBuffer::ringPixelCount];
+    GlassesBuffer frame;
+
+    uint8_t numLights = 0;
 
     bool useCustomColor = false;
     float hue = (65536 / 6) * 3.0;
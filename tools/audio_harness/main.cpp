@@ -0,0 +1,234 @@
+// Replays a 16 kHz mono 16-bit WAV file through the same PdmRecorder,
+// AudioAnalyzer, LogFilterbank and ColumnBars code the glasses run, one audio
+// block at a time, and writes what they produced for each block as CSV.
+// Timing for the whole pipeline is reported at the end.
+//
+//     pio run -e audio_harness
+//     .pio/build/audio_harness/program input.wav [output.csv]
+//
+// Without an output file the CSV goes to stdout; the timing always goes to stderr.
+
+#include <Arduino.h>
+#include <PDM.h>
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+#include "PdmRecorder.h"
+#include "AudioAnalyzer.h"
+#include "ColumnBars.h"
+#include "LogFilterbank.h"
+
+PDMClass PDM;
+
+static HarnessCoreDebug coreDebug;
+static HarnessDWT dwt;
+HarnessCoreDebug* CoreDebug = &coreDebug;
+HarnessDWT* DWT = &dwt;
+
+// The same as AudioBarsScene's matrix.
+typedef LogFilterbank<18, 50, 5000> Filterbank;
+typedef ColumnBars<Filterbank::bandCount> Bars;
+
+// Roughly the analyzer's bass, mids and highs, to compare with the spectrum.
+static const GoertzelBand filterBands[] = {
+    {150, 50},
+    {800, 200},
+    {4000, 1000},
+};
+
+namespace {
+    uint32_t readLE(const uint8_t* p, uint8_t bytes) {
+        uint32_t value = 0;
+
+        for (uint8_t i = 0; i < bytes; i++) {
+            value |= uint32_t(p[i]) << (i * 8);
+        }
+
+        return value;
+    }
+
+    // Only plain PCM, mono, 16-bit, at the recorder's sample rate, since that's what the mic gives us.
+    bool readWav(const char* path, std::vector<int16_t>& samples) {
+        FILE* file = fopen(path, "rb");
+
+        if (file == nullptr) {
+            fprintf(stderr, "Can't open %s\n", path);
+            return false;
+        }
+
+        std::vector<uint8_t> bytes;
+        uint8_t chunk[4096];
+        size_t count;
+
+        while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            bytes.insert(bytes.end(), chunk, chunk + count);
+        }
+
+        fclose(file);
+
+        if (bytes.size() < 12 || memcmp(&bytes[0], "RIFF", 4) != 0 || memcmp(&bytes[8], "WAVE", 4) != 0) {
+            fprintf(stderr, "%s isn't a WAV file\n", path);
+            return false;
+        }
+
+        bool hasFormat = false;
+        size_t offset = 12;
+
+        while (offset + 8 <= bytes.size()) {
+            const uint8_t* header = &bytes[offset];
+            uint32_t size = readLE(header + 4, 4);
+            size_t bodyOffset = offset + 8;
+
+            if (memcmp(header, "fmt ", 4) == 0 && size >= 16 && bodyOffset + 16 <= bytes.size()) {
+                const uint8_t* format = &bytes[bodyOffset];
+                uint16_t encoding = readLE(format, 2);
+                uint16_t channels = readLE(format + 2, 2);
+                uint32_t sampleRate = readLE(format + 4, 4);
+                uint16_t bits = readLE(format + 14, 2);
+
+                if (encoding != 1 || channels != 1 || sampleRate != PdmRecorder::defaultSampleRate || bits != 16) {
+                    fprintf(stderr, "%s is %u channel, %u Hz, %u bit (format %u); need mono 16-bit PCM at %lu Hz\n",
+                        path, channels, sampleRate, bits, encoding, (unsigned long)PdmRecorder::defaultSampleRate);
+                    return false;
+                }
+
+                hasFormat = true;
+            }
+            else if (memcmp(header, "data", 4) == 0) {
+                if (!hasFormat) {
+                    fprintf(stderr, "%s has no format before its data\n", path);
+                    return false;
+                }
+
+                size = min(size_t(size), bytes.size() - bodyOffset);
+                samples.resize(size / 2);
+
+                for (size_t i = 0; i < samples.size(); i++) {
+                    samples[i] = int16_t(readLE(&bytes[bodyOffset + i * 2], 2));
+                }
+
+                return true;
+            }
+
+            // Chunks are padded to an even size.
+            offset = bodyOffset + size + (size & 1);
+        }
+
+        fprintf(stderr, "%s has no data\n", path);
+        return false;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s input.wav [output.csv]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<int16_t> samples;
+
+    if (!readWav(argv[1], samples)) {
+        return 1;
+    }
+
+    FILE* csv = stdout;
+
+    if (argc > 2) {
+        csv = fopen(argv[2], "w");
+
+        if (csv == nullptr) {
+            fprintf(stderr, "Can't write %s\n", argv[2]);
+            return 1;
+        }
+    }
+
+    // These are big, like they'd be as globals on the glasses.
+    static PdmRecorder recorder;
+    static AudioAnalyzer analyzer(recorder);
+    static Filterbank filterbank;
+    static Bars bars;
+
+    recorder.startRecording();
+    analyzer.setSpectrumEnabled(true);
+    analyzer.setLongWindowEnabled(true);
+    analyzer.setFilterBands(filterBands, 3);
+    analyzer.setSoundGesturesEnabled(true);
+
+    fprintf(csv, "block,time_ms,rms,level,peak,onsets,bpm,claps,double_claps,whistle_hz");
+
+    for (int i = 0; i < analyzer.features().filterBandCount; i++) {
+        fprintf(csv, ",filter%d", i);
+    }
+
+    for (int i = 0; i < Bars::columnCount; i++) {
+        fprintf(csv, ",top%d", i);
+    }
+
+    for (int i = 0; i < Bars::columnCount; i++) {
+        fprintf(csv, ",dot%d", i);
+    }
+
+    fprintf(csv, "\n");
+
+    const uint32_t blockSize = recorder.blockSize();
+    const uint32_t blockMillis = blockSize * 1000 / recorder.sampleRate();
+    uint32_t blockCount = samples.size() / blockSize;
+
+    std::chrono::nanoseconds total(0);
+    std::chrono::nanoseconds slowest(0);
+
+    for (uint32_t block = 0; block < blockCount; block++) {
+        auto start = std::chrono::steady_clock::now();
+
+        // One PDM callback's worth of samples, then one frame's worth of work.
+        PDM.feed(&samples[block * blockSize], blockSize);
+        recorder.readPdmData();
+        recorder.sync();
+
+        if (analyzer.update()) {
+            filterbank.analyze(analyzer.features());
+            bars.analyze(filterbank.getBands(), analyzer.features().spectrumCeiling, analyzer.features().timeMs);
+        }
+
+        bars.update(blockMillis);
+
+        for (uint32_t t = 0; t < blockMillis; t += Bars::fallStepMs) {
+            bars.fall();
+        }
+
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        total += elapsed;
+        slowest = max(slowest, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed));
+
+        const AudioFeatures& features = analyzer.features();
+        fprintf(csv, "%u,%u,%.2f,%.3f,%u,%u,%.1f,%u,%u,%.0f", block, block * blockMillis, features.rms, features.level, features.peak,
+            features.onsetCount, features.bpm, features.clapCount, features.doubleClapCount, features.whistleHz);
+
+        for (int i = 0; i < features.filterBandCount; i++) {
+            fprintf(csv, ",%.3f", features.filterBandLevels[i]);
+        }
+
+        for (int i = 0; i < Bars::columnCount; i++) {
+            fprintf(csv, ",%.3f", bars.getColumnTop(i));
+        }
+
+        for (int i = 0; i < Bars::columnCount; i++) {
+            fprintf(csv, ",%.3f", bars.getColumnDot(i));
+        }
+
+        fprintf(csv, "\n");
+    }
+
+    if (csv != stdout) {
+        fclose(csv);
+    }
+
+    recorder.stopRecording();
+
+    if (blockCount > 0) {
+        fprintf(stderr, "%u blocks of %u samples: %.0f ns/block average, %lld ns slowest\n",
+            blockCount, blockSize, double(total.count()) / blockCount, (long long)slowest.count());
+    }
+
+    return 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// Just enough of the Arduino core for the audio code to build on the host.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+template<class A, class B> inline auto min(A a, B b) -> decltype(a + b) { return a < b ? a : b; }
+template<class A, class B> inline auto max(A a, B b) -> decltype(a + b) { return a > b ? a : b; }
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+// There's no cycle counter to read, so CycleCounter just reads zero.
+// The harness times blocks itself.
+struct HarnessCoreDebug {
+    uint32_t DEMCR;
+};
+
+struct HarnessDWT {
+    uint32_t CTRL;
+    uint32_t CYCCNT;
+};
+
+extern HarnessCoreDebug* CoreDebug;
+extern HarnessDWT* DWT;
+
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Stands in for the nRF52 PDM library. Instead of a mic, the harness
+// queues up samples with feed(), then calls the recorder's readPdmData()
+// just like the real PDM callback would.
+class PDMClass {
+public:
+    void onReceive(void (*callback)(void)) {}
+    int begin(int channels, long sampleRate) { return 1; }
+    void end() {}
+    void setGain(int gain) {}
+    void setBufferSize(int size) {}
+
+    void feed(const int16_t* samples, uint32_t count) {
+        pending = samples;
+        pendingBytes = count * 2;
+    }
+
+    int available() {
+        return pendingBytes;
+    }
+
+    int read(void* buffer, int size) {
+        size = min(size, pendingBytes);
+        memcpy(buffer, pending, size);
+        pending += size / 2;
+        pendingBytes -= size;
+        return size;
+    }
+
+private:
+    const int16_t* pending = nullptr;
+    int pendingBytes = 0;
+};
+
+extern PDMClass PDM;